@@ -40,6 +40,7 @@ void Settings::set_working_dir(std::string working_dir) {
     m_boxart_dir = working_dir + "/boxart";
     m_log_path = working_dir + "/log.txt";
     m_gamepad_mapping_path = working_dir + "/gamepad_mapping_v1.2.0.json";
+    m_audio_record_path = working_dir + "/audio.wav";
     
     mkdirtree(m_working_dir.c_str());
     mkdirtree(m_key_dir.c_str());
@@ -120,6 +121,12 @@ void Settings::load() {
                 }
             }
             
+            if (json_t* audio_channels = json_object_get(settings, "audio_channels")) {
+                if (json_typeof(audio_channels) == JSON_INTEGER) {
+                    m_audio_channels = (AudioChannels)json_integer_value(audio_channels);
+                }
+            }
+            
             if (json_t* bitrate = json_object_get(settings, "bitrate")) {
                 if (json_typeof(bitrate) == JSON_INTEGER) {
                     m_bitrate = (int)json_integer_value(bitrate);
@@ -134,6 +141,14 @@ void Settings::load() {
                 m_click_by_tap = json_typeof(click_by_tap) == JSON_TRUE;
             }
             
+            if (json_t* local_cursor = json_object_get(settings, "local_cursor")) {
+                m_local_cursor = json_typeof(local_cursor) == JSON_TRUE;
+            }
+            
+            if (json_t* relative_mouse = json_object_get(settings, "relative_mouse")) {
+                m_relative_mouse = json_typeof(relative_mouse) == JSON_TRUE;
+            }
+            
             if (json_t* decoder_threads = json_object_get(settings, "decoder_threads")) {
                 if (json_typeof(decoder_threads) == JSON_INTEGER) {
                     m_decoder_threads = (int)json_integer_value(decoder_threads);
@@ -148,9 +163,21 @@ void Settings::load() {
                 m_play_audio = json_typeof(play_audio) == JSON_TRUE;
             }
             
+            if (json_t* av_sync = json_object_get(settings, "av_sync")) {
+                m_av_sync = json_typeof(av_sync) == JSON_TRUE;
+            }
+            
             if (json_t* write_log = json_object_get(settings, "write_log")) {
                 m_write_log = json_typeof(write_log) == JSON_TRUE;
             }
+            
+            if (json_t* use_pbo = json_object_get(settings, "use_pbo")) {
+                m_use_pbo = json_typeof(use_pbo) == JSON_TRUE;
+            }
+            
+            if (json_t* record_audio = json_object_get(settings, "record_audio")) {
+                m_record_audio = json_typeof(record_audio) == JSON_TRUE;
+            }
         }
         
         json_decref(root);
@@ -178,12 +205,18 @@ void Settings::save() {
             json_object_set(settings, "fps", json_integer(m_fps));
             json_object_set(settings, "video_codec", json_integer(m_video_codec));
             json_object_set(settings, "bitrate", json_integer(m_bitrate));
+            json_object_set(settings, "audio_channels", json_integer(m_audio_channels));
             json_object_set(settings, "ignore_unsupported_resolutions", m_ignore_unsupported_resolutions ? json_true() : json_false());
             json_object_set(settings, "decoder_threads", json_integer(m_decoder_threads));
             json_object_set(settings, "click_by_tap", m_click_by_tap ? json_true() : json_false());
+            json_object_set(settings, "local_cursor", m_local_cursor ? json_true() : json_false());
+            json_object_set(settings, "relative_mouse", m_relative_mouse ? json_true() : json_false());
             json_object_set(settings, "sops", m_sops ? json_true() : json_false());
             json_object_set(settings, "play_audio", m_play_audio ? json_true() : json_false());
+            json_object_set(settings, "av_sync", m_av_sync ? json_true() : json_false());
             json_object_set(settings, "write_log", m_write_log ? json_true() : json_false());
+            json_object_set(settings, "use_pbo", m_use_pbo ? json_true() : json_false());
+            json_object_set(settings, "record_audio", m_record_audio ? json_true() : json_false());
             json_object_set(root, "settings", settings);
         }
         
@@ -6,7 +6,14 @@
 
 enum VideoCodec: int {
     H264,
-    H265
+    H265,
+    H265_MAIN10
+};
+
+enum AudioChannels: int {
+    STEREO,
+    SURROUND_51,
+    SURROUND_71
 };
 
 struct Host {
@@ -35,6 +42,10 @@ public:
         return m_gamepad_mapping_path;
     }
     
+    std::string audio_record_path() const {
+        return m_audio_record_path;
+    }
+    
     std::vector<Host> hosts() const {
         return m_hosts;
     }
@@ -66,6 +77,14 @@ public:
         m_video_codec = video_codec;
     }
     
+    AudioChannels audio_channels() const {
+        return m_audio_channels;
+    }
+    
+    void set_audio_channels(AudioChannels audio_channels) {
+        m_audio_channels = audio_channels;
+    }
+    
     int bitrate() const {
         return m_bitrate;
     }
@@ -90,6 +109,22 @@ public:
         m_click_by_tap = click_by_tap;
     }
     
+    bool local_cursor() const {
+        return m_local_cursor;
+    }
+    
+    void set_local_cursor(bool local_cursor) {
+        m_local_cursor = local_cursor;
+    }
+    
+    bool relative_mouse() const {
+        return m_relative_mouse;
+    }
+    
+    void set_relative_mouse(bool relative_mouse) {
+        m_relative_mouse = relative_mouse;
+    }
+    
     void set_decoder_threads(int decoder_threads) {
         m_decoder_threads = decoder_threads;
     }
@@ -114,6 +149,14 @@ public:
         return m_play_audio;
     }
     
+    void set_av_sync(bool av_sync) {
+        m_av_sync = av_sync;
+    }
+    
+    bool av_sync() const {
+        return m_av_sync;
+    }
+    
     void set_write_log(int write_log) {
         m_write_log = write_log;
     }
@@ -122,6 +165,24 @@ public:
         return m_write_log;
     }
     
+    void set_use_pbo(bool use_pbo) {
+        m_use_pbo = use_pbo;
+    }
+    
+    bool use_pbo() const {
+        return m_use_pbo;
+    }
+    
+    // Desktop builds only: record the stream audio to audio_record_path,
+    // instead of the null sink with a simulated device clock
+    void set_record_audio(bool record_audio) {
+        m_record_audio = record_audio;
+    }
+    
+    bool record_audio() const {
+        return m_record_audio;
+    }
+    
     void load();
     void save();
 
@@ -131,16 +192,23 @@ private:
     std::string m_boxart_dir;
     std::string m_log_path;
     std::string m_gamepad_mapping_path;
+    std::string m_audio_record_path;
     
     std::vector<Host> m_hosts;
     int m_resolution = 720;
     int m_fps = 60;
     VideoCodec m_video_codec = H264;
     int m_bitrate = 10000;
+    AudioChannels m_audio_channels = STEREO;
     bool m_ignore_unsupported_resolutions = false;
     bool m_click_by_tap = false;
+    bool m_local_cursor = false;
+    bool m_relative_mouse = false;
     int m_decoder_threads = 4;
     bool m_sops = true;
     bool m_play_audio = false;
+    bool m_av_sync = false;
     bool m_write_log = false;
+    bool m_use_pbo = false;
+    bool m_record_audio = false;
 };
@@ -2,6 +2,9 @@
 #include "Application.hpp"
 #include <nanogui/opengl.h>
 #include <GLFW/glfw3.h>
+#include <Limelight.h>
+
+#define HID_MOUSE_STATES_COUNT 16
 
 void MouseController::init(GLFWwindow* window) {
     hidInitializeMouse();
@@ -21,9 +24,20 @@ void MouseController::init(GLFWwindow* window) {
 }
 
 void MouseController::handle_mouse() {
-    HidMouseState hid_mouse_state;
+    HidMouseState hid_mouse_states[HID_MOUSE_STATES_COUNT];
+    size_t count = hidGetMouseStates(hid_mouse_states, HID_MOUSE_STATES_COUNT);
     
-    if (hidGetMouseStates(&hid_mouse_state, 1) && (hid_mouse_state.attributes & HidMouseAttribute_IsConnected)) {
+    if (count > 0 && (hid_mouse_states[0].attributes & HidMouseAttribute_IsConnected)) {
+        auto &hid_mouse_state = hid_mouse_states[0];
+        
+        if (m_stream_mouse_is_relative) {
+            // Newest first, sum the motion of every sample since the last frame
+            for (size_t i = 0; i < count && hid_mouse_states[i].sampling_number > m_hid_mouse_state.sampling_number; i++) {
+                m_delta_x += hid_mouse_states[i].delta_x;
+                m_delta_y += hid_mouse_states[i].delta_y;
+            }
+        }
+        
         if (m_hid_mouse_state.x != hid_mouse_state.x || m_hid_mouse_state.y != hid_mouse_state.y || m_hid_mouse_state.buttons != hid_mouse_state.buttons || m_hid_mouse_state.wheel_delta_x != hid_mouse_state.wheel_delta_x) {
             m_hid_mouse_is_used = true;
             m_hid_mouse_state = hid_mouse_state;
@@ -54,6 +68,8 @@ void MouseController::handle_mouse() {
             
             set_new_mouse_state(state);
         }
+        
+        m_hid_mouse_state.sampling_number = hid_mouse_state.sampling_number;
     } else {
         m_hid_mouse_is_used = false;
     }
@@ -79,8 +95,19 @@ void MouseController::handle_mouse() {
     }
 }
 
+bool MouseController::cursor_is_visible() const {
+    return m_hid_mouse_is_used && m_draw_cursor_for_hid_mouse && !m_stream_mouse_is_relative;
+}
+
+void MouseController::take_relative_motion(int *delta_x, int *delta_y) {
+    *delta_x = m_delta_x;
+    *delta_y = m_delta_y;
+    m_delta_x = 0;
+    m_delta_y = 0;
+}
+
 void MouseController::draw_cursor(Application *app) {
-    if (m_hid_mouse_is_used && m_draw_cursor_for_hid_mouse) {
+    if (cursor_is_visible()) {
         auto ctx = app->nvg_context();
         nvgSave(ctx);
         nvgReset(ctx);
@@ -38,11 +38,34 @@ public:
         m_draw_cursor_for_hid_mouse = draw_cursor_for_hid_mouse;
     }
     
+    // Selects the stream input path of the HID mouse. The host draws its cursor at
+    // the absolute positions it gets, relative motion goes to a game that captured
+    // (and hid) it, so there is no cursor to draw locally
+    void set_stream_mouse_is_relative(bool stream_mouse_is_relative) {
+        m_stream_mouse_is_relative = stream_mouse_is_relative;
+        m_delta_x = 0;
+        m_delta_y = 0;
+    }
+    
+    bool stream_mouse_is_relative() const {
+        return m_stream_mouse_is_relative;
+    }
+    
+    // GameStream doesn't tell the client when a game captures the cursor, so it's
+    // hidden only by the relative mouse setting, which the user turns on for such games
+    bool cursor_is_visible() const;
+    
+    // HID mouse motion since the last call, not clamped to the screen like the position
+    void take_relative_motion(int *delta_x, int *delta_y);
+    
 private:
     MouseState m_mouse_state = {0};
     HidMouseState m_hid_mouse_state = {0};
     bool m_hid_mouse_is_used = false;
     bool m_draw_cursor_for_hid_mouse = true;
+    bool m_stream_mouse_is_relative = false;
+    int m_delta_x = 0;
+    int m_delta_y = 0;
     double m_last_touch_y = 0;
     
     void handle_mouse_move(double x, double y);
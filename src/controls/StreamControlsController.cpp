@@ -20,7 +20,14 @@ void StreamControlsController::send_to_stream(int width, int height) {
     auto mouse_state = MouseController::instance().mouse_state();
     
     if (MouseController::instance().hid_mouse_is_used()) {
-        if (mouse_state.x != m_mouse_state.x || mouse_state.y != m_mouse_state.y) {
+        if (MouseController::instance().stream_mouse_is_relative()) {
+            int delta_x, delta_y;
+            MouseController::instance().take_relative_motion(&delta_x, &delta_y);
+            
+            if (delta_x != 0 || delta_y != 0) {
+                LiSendMouseMoveEvent(delta_x, delta_y);
+            }
+        } else if (mouse_state.x != m_mouse_state.x || mouse_state.y != m_mouse_state.y) {
             LiSendMousePositionEvent(m_mouse_state.x, m_mouse_state.y, width, height);
         }
         
@@ -1,5 +1,6 @@
 #include "Data.hpp"
 #include <string.h>
+#include <time.h>
 #include <cstdlib>
 #include "Logger.hpp"
 
@@ -24,6 +24,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <mutex>
 #include <Limelight.h>
 #include "Settings.hpp"
 #include "CryptoManager.hpp"
@@ -31,100 +32,124 @@
 
 #define CHANNEL_COUNT_STEREO 2
 #define CHANNEL_COUNT_51_SURROUND 6
+#define CHANNEL_COUNT_71_SURROUND 8
 
 #define CHANNEL_MASK_STEREO 0x3
 #define CHANNEL_MASK_51_SURROUND 0xFC
+#define CHANNEL_MASK_71_SURROUND 0x63F
 
 static std::string unique_id = "0123456789ABCDEF";
 
+// surroundAudioInfo of the launch request, a channel mask in high 16 bits and a channel count in low
+static int surround_audio_info(int audio_configuration) {
+    switch (audio_configuration) {
+        case AUDIO_CONFIGURATION_51_SURROUND:
+            return (CHANNEL_MASK_51_SURROUND << 16) + CHANNEL_COUNT_51_SURROUND;
+        #ifdef AUDIO_CONFIGURATION_71_SURROUND
+        case AUDIO_CONFIGURATION_71_SURROUND:
+            return (CHANNEL_MASK_71_SURROUND << 16) + CHANNEL_COUNT_71_SURROUND;
+        #endif
+        default:
+            return (CHANNEL_MASK_STEREO << 16) + CHANNEL_COUNT_STEREO;
+    }
+}
+
+static int parse_server_status(HTTP_XML_REQUEST *request, PSERVER_INFO_XML info) {
+    if (request->status != GS_OK) {
+        xml_stream_free(request->stream);
+        return request->status == GS_INVALID ? GS_INVALID : GS_IO_ERROR;
+    }
+    
+    int status = xml_stream_finish(request->stream);
+    
+    if (status != GS_OK) {
+        request->error = gs_error();
+        return status;
+    }
+    
+    // These fields are present on all version of GFE that this client supports
+    if (info->currentGame.empty() || info->pairStatus.empty() || info->appVersion.empty() || info->state.empty()) {
+        request->error = "Invalid server info";
+        return GS_INVALID;
+    }
+    return GS_OK;
+}
+
+static void apply_server_status(PSERVER_DATA server, PSERVER_INFO_XML info) {
+    server->serverInfoAppVersion = info->appVersion;
+    server->gpuType = info->gpuType;
+    server->gsVersion = info->gsVersion;
+    server->hostname = info->hostname;
+    server->serverInfoGfeVersion = info->gfeVersion;
+    server->mac = info->mac;
+    server->modes = info->modes;
+    
+    server->paired = info->pairStatus == "1";
+    server->currentGame = atoi(info->currentGame.c_str());
+    server->supports4K = !info->serverCodecModeSupport.empty();
+    server->serverMajorVersion = atoi(server->serverInfoAppVersion.c_str());
+    
+    if (info->state == "_SERVER_BUSY") {
+        // After GFE 2.8, current game remains set even after streaming
+        // has ended. We emulate the old behavior by forcing it to zero
+        // if streaming is not active.
+        server->currentGame = 0;
+    }
+}
+
 static int load_server_status(PSERVER_DATA server, bool skip_https) {
-    int ret;
     char url[4096];
-    int i = skip_https ? 1 : 0;
+    int first = skip_https ? 1 : 0;
+    
+    // Modern GFE versions don't allow serverinfo to be fetched over HTTPS if the client
+    // is not already paired. Since we can't pair without knowing the server version, we
+    // make another request over HTTP if the HTTPS request fails. We can't just use HTTP
+    // for everything because it doesn't accurately tell us if we're paired.
+    // Both requests run at once, a valid HTTPS answer wins and cancels HTTP,
+    // a HTTP answer is used only after HTTPS fails.
+    
+    SERVER_INFO_XML infos[2];
+    HTTP_XML_REQUEST requests[2];
+    int results[2] = { GS_INVALID, GS_INVALID };
+    bool is_finished[2] = { false, false };
+    
+    for (int i = first; i < 2; i++) {
+        snprintf(url, sizeof(url), "%s://%s:%d/serverinfo?uniqueid=%s", i == 0 ? "https" : "http", server->serverInfo.address, i == 0 ? GAMESTREAM_HTTPS_PORT : GAMESTREAM_HTTP_PORT, unique_id.c_str());
+        requests[i].url = url;
+        requests[i].stream = xml_serverinfo_stream(&infos[i]);
+    }
+    
+    http_request_concurrent(&requests[first], 2 - first, HTTPRequestTimeoutLow, [&](int index) {
+        int i = first + index;
+        is_finished[i] = true;
+        results[i] = parse_server_status(&requests[i], &infos[i]);
+        return i == 0 && results[i] == GS_OK;
+    });
+    
+    int i = results[0] == GS_OK && !skip_https ? 0 : 1;
+    int ret = results[i];
+    
+    if (ret == GS_OK) {
+        apply_server_status(server, &infos[i]);
+    } else {
+        gs_set_error(requests[i].error);
+    }
     
-    do {
-        std::string pairedText;
-        std::string currentGameText;
-        std::string stateText;
-        std::string serverCodecModeSupportText;
-        
-        ret = GS_INVALID;
-        
-        // Modern GFE versions don't allow serverinfo to be fetched over HTTPS if the client
-        // is not already paired. Since we can't pair without knowing the server version, we
-        // make another request over HTTP if the HTTPS request fails. We can't just use HTTP
-        // for everything because it doesn't accurately tell us if we're paired.
-        
-        snprintf(url, sizeof(url), "%s://%s:%d/serverinfo?uniqueid=%s", i == 0 ? "https" : "http", server->serverInfo.address, i == 0 ? 47984 : 47989, unique_id.c_str());
-        
-        Data data;
-        
-        if (http_request(url, &data, HTTPRequestTimeoutLow) != GS_OK) {
-            ret = GS_IO_ERROR;
-            goto cleanup;
-        }
-        
-        if (xml_status(data) == GS_ERROR) {
-            ret = GS_ERROR;
-            goto cleanup;
-        }
-        
-        if (xml_search(data, "currentgame", &currentGameText) != GS_OK) {
-            goto cleanup;
-        }
-        
-        if (xml_search(data, "PairStatus", &pairedText) != GS_OK)
-            goto cleanup;
-        
-        if (xml_search(data, "appversion", &server->serverInfoAppVersion) != GS_OK) {
-            goto cleanup;
+    for (int j = first; j < 2; j++) {
+        // A cancelled request wasn't parsed
+        if (!is_finished[j]) {
+            xml_stream_free(requests[j].stream);
         }
         
-        if (xml_search(data, "state", &stateText) != GS_OK)
-            goto cleanup;
-        
-        if (xml_search(data, "ServerCodecModeSupport", &serverCodecModeSupportText) != GS_OK)
-            goto cleanup;
-        
-        if (xml_search(data, "gputype", &server->gpuType) != GS_OK)
-            goto cleanup;
-        
-        if (xml_search(data, "GsVersion", &server->gsVersion) != GS_OK)
-            goto cleanup;
-        
-        if (xml_search(data, "hostname", &server->hostname) != GS_OK)
-            goto cleanup;
-        
-        if (xml_search(data, "GfeVersion", &server->serverInfoGfeVersion) != GS_OK)
-            goto cleanup;
-        
-        if (xml_search(data, "mac", &server->mac) != GS_OK)
-            goto cleanup;
-        
-        if (xml_modelist(data, &server->modes) != GS_OK)
-            goto cleanup;
-        
-        // These fields are present on all version of GFE that this client supports
-        if (currentGameText.empty() || pairedText.empty() || server->serverInfoAppVersion.empty() || stateText.empty()) {
-            goto cleanup;
-        }
-        
-        server->paired = pairedText == "1";
-        server->currentGame = currentGameText.empty() ? 0 : atoi(currentGameText.c_str());
-        server->supports4K = !serverCodecModeSupportText.empty();
-        server->serverMajorVersion = atoi(server->serverInfoAppVersion.c_str());
-        
-        if (stateText == "_SERVER_BUSY") {
-            // After GFE 2.8, current game remains set even after streaming
-            // has ended. We emulate the old behavior by forcing it to zero
-            // if streaming is not active.
-            server->currentGame = 0;
+        // Display modes of the losing answer
+        if (j != i || ret != GS_OK) {
+            while (infos[j].modes) {
+                PDISPLAY_MODE next = infos[j].modes->next;
+                free(infos[j].modes);
+                infos[j].modes = next;
+            }
         }
-        ret = GS_OK;
-        
-    cleanup:
-        i++;
-    } while (ret != GS_OK && i < 2);
+    }
     
     if (ret == GS_OK && !server->unsupported) {
         if (server->serverMajorVersion > MAX_SUPPORTED_GFE_VERSION) {
@@ -139,7 +164,8 @@ static int load_server_status(PSERVER_DATA server, bool skip_https) {
     return ret;
 }
 
-static std::string _gs_error = "";
+// Requests run on several workers, each has own last error
+static thread_local std::string _gs_error = "";
 
 void gs_set_error(std::string error) {
     _gs_error = error;
@@ -152,14 +178,15 @@ std::string gs_error() {
     return _gs_error;
 }
 
-int gs_unpair(PSERVER_DATA server) {
+int gs_unpair(const SERVER_DATA *server) {
     int ret = GS_OK;
     char url[4096];
     
     Data data;
     
-    snprintf(url, sizeof(url), "http://%s:47989/unpair?uniqueid=%s", server->serverInfo.address, unique_id.c_str());
+    snprintf(url, sizeof(url), "http://%s:%d/unpair?uniqueid=%s", server->serverInfo.address, GAMESTREAM_HTTP_PORT, unique_id.c_str());
     ret = http_request(url, &data, HTTPRequestTimeoutLow);
+    http_reset_sessions();
     return ret;
 }
 
@@ -167,7 +194,7 @@ static int gs_pair_validate(Data &data, std::string* result) {
     *result = "";
     
     int ret = GS_OK;
-    if ((ret = xml_status(data) != GS_OK)) {
+    if ((ret = xml_status(data)) != GS_OK) {
         return ret;
     } else if ((ret = xml_search(data, "paired", result)) != GS_OK) {
         return ret;
@@ -184,6 +211,8 @@ static int gs_pair_validate(Data &data, std::string* result) {
 static int gs_pair_cleanup(int ret, PSERVER_DATA server, std::string* result) {
     if (ret != GS_OK) {
         gs_unpair(server);
+    } else {
+        http_reset_sessions();
     }
     return ret;
 }
@@ -211,13 +240,13 @@ int gs_pair(PSERVER_DATA server, char* pin) {
     Data salted_pin = salt.append(Data(pin, strlen(pin)));
     Logger::info("Client", "PIN: %s, salt %s", pin, salt.hex().bytes());
     
-    snprintf(url, sizeof(url), "http://%s:47989/pair?uniqueid=%s&devicename=roth&updateState=1&phrase=getservercert&salt=%s&clientcert=%s", server->serverInfo.address, unique_id.c_str(), salt.hex().bytes(), CryptoManager::cert_data().hex().bytes());
+    snprintf(url, sizeof(url), "http://%s:%d/pair?uniqueid=%s&devicename=roth&updateState=1&phrase=getservercert&salt=%s&clientcert=%s", server->serverInfo.address, GAMESTREAM_HTTP_PORT, unique_id.c_str(), salt.hex().bytes(), CryptoManager::cert_data().hex().bytes());
     
     if ((ret = http_request(url, &data, HTTPRequestTimeoutLong)) != GS_OK) {
         return gs_pair_cleanup(ret, server, &result);
     }
     
-    if ((ret = gs_pair_validate(data, &result) != GS_OK)) {
+    if ((ret = gs_pair_validate(data, &result)) != GS_OK) {
         return gs_pair_cleanup(ret, server, &result);
     }
     
@@ -244,13 +273,13 @@ int gs_pair(PSERVER_DATA server, char* pin) {
     Data randomChallenge = Data::random_bytes(16);
     Data encryptedChallenge = CryptoManager::aes_encrypt(randomChallenge, aesKey);
     
-    snprintf(url, sizeof(url), "http://%s:47989/pair?uniqueid=%s&devicename=roth&updateState=1&clientchallenge=%s", server->serverInfo.address, unique_id.c_str(), encryptedChallenge.hex().bytes());
+    snprintf(url, sizeof(url), "http://%s:%d/pair?uniqueid=%s&devicename=roth&updateState=1&clientchallenge=%s", server->serverInfo.address, GAMESTREAM_HTTP_PORT, unique_id.c_str(), encryptedChallenge.hex().bytes());
     
     if ((ret = http_request(url, &data, HTTPRequestTimeoutLong)) != GS_OK) {
         return gs_pair_cleanup(ret, server, &result);
     }
     
-    if ((ret = gs_pair_validate(data, &result) != GS_OK)) {
+    if ((ret = gs_pair_validate(data, &result)) != GS_OK) {
         return gs_pair_cleanup(ret, server, &result);
     }
     
@@ -279,13 +308,13 @@ int gs_pair(PSERVER_DATA server, char* pin) {
     }
     Data challengeRespEncrypted = CryptoManager::aes_encrypt(challengeRespHash, aesKey);
     
-    snprintf(url, sizeof(url), "http://%s:47989/pair?uniqueid=%s&devicename=roth&updateState=1&serverchallengeresp=%s", server->serverInfo.address, unique_id.c_str(), challengeRespEncrypted.hex().bytes());
+    snprintf(url, sizeof(url), "http://%s:%d/pair?uniqueid=%s&devicename=roth&updateState=1&serverchallengeresp=%s", server->serverInfo.address, GAMESTREAM_HTTP_PORT, unique_id.c_str(), challengeRespEncrypted.hex().bytes());
     
     if ((ret = http_request(url, &data, HTTPRequestTimeoutLong)) != GS_OK) {
         return gs_pair_cleanup(ret, server, &result);
     }
     
-    if ((ret = gs_pair_validate(data, &result) != GS_OK)) {
+    if ((ret = gs_pair_validate(data, &result)) != GS_OK) {
         return gs_pair_cleanup(ret, server, &result);
     }
     
@@ -317,23 +346,23 @@ int gs_pair(PSERVER_DATA server, char* pin) {
     
     Data clientPairingSecret = clientSecret.append(CryptoManager::sign_data(clientSecret, CryptoManager::key_data()));
     
-    snprintf(url, sizeof(url), "http://%s:47989/pair?uniqueid=%s&devicename=roth&updateState=1&clientpairingsecret=%s", server->serverInfo.address, unique_id.c_str(), clientPairingSecret.hex().bytes());
+    snprintf(url, sizeof(url), "http://%s:%d/pair?uniqueid=%s&devicename=roth&updateState=1&clientpairingsecret=%s", server->serverInfo.address, GAMESTREAM_HTTP_PORT, unique_id.c_str(), clientPairingSecret.hex().bytes());
     if ((ret = http_request(url, &data, HTTPRequestTimeoutLong)) != GS_OK) {
         return gs_pair_cleanup(ret, server, &result);
     }
     
-    if ((ret = gs_pair_validate(data, &result) != GS_OK)) {
+    if ((ret = gs_pair_validate(data, &result)) != GS_OK) {
         return gs_pair_cleanup(ret, server, &result);
     }
     
     Logger::info("Client", "Start pairing stage #5");
     
-    snprintf(url, sizeof(url), "https://%s:47984/pair?uniqueid=%s&devicename=roth&updateState=1&phrase=pairchallenge", server->serverInfo.address, unique_id.c_str());
+    snprintf(url, sizeof(url), "https://%s:%d/pair?uniqueid=%s&devicename=roth&updateState=1&phrase=pairchallenge", server->serverInfo.address, GAMESTREAM_HTTPS_PORT, unique_id.c_str());
     if ((ret = http_request(url, &data, HTTPRequestTimeoutLong)) != GS_OK) {
         return gs_pair_cleanup(ret, server, &result);
     }
     
-    if ((ret = gs_pair_validate(data, &result) != GS_OK)) {
+    if ((ret = gs_pair_validate(data, &result)) != GS_OK) {
         return gs_pair_cleanup(ret, server, &result);
     }
     
@@ -342,28 +371,29 @@ int gs_pair(PSERVER_DATA server, char* pin) {
     return gs_pair_cleanup(ret, server, &result);
 }
 
-int gs_applist(PSERVER_DATA server, PAPP_LIST *list) {
+int gs_applist(const SERVER_DATA *server, PAPP_LIST list) {
     int ret = GS_OK;
     char url[4096];
-    Data data;
     
-    snprintf(url, sizeof(url), "https://%s:47984/applist?uniqueid=%s", server->serverInfo.address, unique_id.c_str());
+    snprintf(url, sizeof(url), "https://%s:%d/applist?uniqueid=%s", server->serverInfo.address, GAMESTREAM_HTTPS_PORT, unique_id.c_str());
     
-    if (http_request(url, &data, HTTPRequestTimeoutMedium) != GS_OK)
-        ret = GS_IO_ERROR;
-    else if (xml_status(data) == GS_ERROR)
-        ret = GS_ERROR;
-    else if (xml_applist(data, list) != GS_OK)
-        ret = GS_INVALID;
+    PXML_STREAM stream = xml_applist_stream(list);
+    
+    if ((ret = http_request(url, stream, HTTPRequestTimeoutMedium)) != GS_OK) {
+        xml_stream_free(stream);
+        ret = ret == GS_INVALID ? GS_INVALID : GS_IO_ERROR;
+    } else {
+        ret = xml_stream_finish(stream);
+    }
     return ret;
 }
 
-int gs_app_boxart(PSERVER_DATA server, int app_id, Data* out) {
+int gs_app_boxart(const SERVER_DATA *server, int app_id, Data* out) {
     int ret = GS_OK;
     char url[4096];
     Data data;
     
-    snprintf(url, sizeof(url), "https://%s:47984/appasset?uniqueid=%s&appid=%d&AssetType=2&AssetIdx=0", server->serverInfo.address, unique_id.c_str(), app_id);
+    snprintf(url, sizeof(url), "https://%s:%d/appasset?uniqueid=%s&appid=%d&AssetType=2&AssetIdx=0", server->serverInfo.address, GAMESTREAM_HTTPS_PORT, unique_id.c_str(), app_id);
     
     if (http_request(url, &data, HTTPRequestTimeoutMedium) != GS_OK) {
         ret = GS_IO_ERROR;
@@ -415,21 +445,19 @@ int gs_start_app(PSERVER_DATA server, STREAM_CONFIGURATION *config, int appId, b
     Data data;
     
     if (server->currentGame == 0) {
-        int channelCounnt = config->audioConfiguration == AUDIO_CONFIGURATION_STEREO ? CHANNEL_COUNT_STEREO : CHANNEL_COUNT_51_SURROUND;
-        int mask = config->audioConfiguration == AUDIO_CONFIGURATION_STEREO ? CHANNEL_MASK_STEREO : CHANNEL_MASK_51_SURROUND;
         int fps = sops && config->fps > 60 ? 60 : config->fps;
-        snprintf(url, sizeof(url), "https://%s:47984/launch?uniqueid=%s&appid=%d&mode=%dx%dx%d&additionalStates=1&sops=%d&rikey=%s&rikeyid=%d&localAudioPlayMode=%d&surroundAudioInfo=%d&remoteControllersBitmap=%d&gcmap=%d", server->serverInfo.address, unique_id.c_str(), appId, config->width, config->height, fps, sops, rand.hex().bytes(), rikeyid, localaudio, (mask << 16) + channelCounnt, gamepad_mask, gamepad_mask);
+        // The host only encodes HEVC Main10 when the HDR mode is requested at launch
+        const char* hdr_params = config->enableHdr ? "&hdrMode=1&clientHdrCapVersion=0&clientHdrCapSupportedFlagsInUint32=0&clientHdrCapMetaDataId=NV_STATIC_METADATA_TYPE_1&clientHdrCapDisplayData=0x0x0x0x0x0x0x0x0x0x0" : "";
+        snprintf(url, sizeof(url), "https://%s:%d/launch?uniqueid=%s&appid=%d&mode=%dx%dx%d&additionalStates=1&sops=%d&rikey=%s&rikeyid=%d&localAudioPlayMode=%d&surroundAudioInfo=%d&remoteControllersBitmap=%d&gcmap=%d%s", server->serverInfo.address, GAMESTREAM_HTTPS_PORT, unique_id.c_str(), appId, config->width, config->height, fps, sops, rand.hex().bytes(), rikeyid, localaudio, surround_audio_info(config->audioConfiguration), gamepad_mask, gamepad_mask, hdr_params);
     } else {
-        snprintf(url, sizeof(url), "https://%s:47984/resume?uniqueid=%s&rikey=%s&rikeyid=%d", server->serverInfo.address, unique_id.c_str(), rand.hex().bytes(), rikeyid);
+        snprintf(url, sizeof(url), "https://%s:%d/resume?uniqueid=%s&rikey=%s&rikeyid=%d", server->serverInfo.address, GAMESTREAM_HTTPS_PORT, unique_id.c_str(), rand.hex().bytes(), rikeyid);
     }
     
-    if ((ret = http_request(url, &data, HTTPRequestTimeoutLong)) == GS_OK) {
-        server->currentGame = appId;
-    } else {
+    if ((ret = http_request(url, &data, HTTPRequestTimeoutLong)) != GS_OK) {
         goto exit;
     }
 
-    if ((ret = xml_status(data) != GS_OK)) {
+    if ((ret = xml_status(data)) != GS_OK) {
         goto exit;
     } else if ((ret = xml_search(data, "gamesession", &result)) != GS_OK) {
         goto exit;
@@ -439,22 +467,25 @@ int gs_start_app(PSERVER_DATA server, STREAM_CONFIGURATION *config, int appId, b
         ret = GS_FAILED;
         goto exit;
     }
+    
+    // Only a launch or resume which the host accepted
+    server->currentGame = appId;
 
 exit:
     return ret;
 }
 
-int gs_quit_app(PSERVER_DATA server) {
+int gs_quit_app(const SERVER_DATA *server) {
     int ret = GS_OK;
     char url[4096];
     std::string result;
     Data data;
     
-    snprintf(url, sizeof(url), "https://%s:47984/cancel?uniqueid=%s", server->serverInfo.address, unique_id.c_str());
+    snprintf(url, sizeof(url), "https://%s:%d/cancel?uniqueid=%s", server->serverInfo.address, GAMESTREAM_HTTPS_PORT, unique_id.c_str());
     if ((ret = http_request(url, &data, HTTPRequestTimeoutMedium)) != GS_OK)
         goto exit;
     
-    if ((ret = xml_status(data) != GS_OK)) {
+    if ((ret = xml_status(data)) != GS_OK) {
         goto exit;
     } else if ((ret = xml_search(data, "cancel", &result)) != GS_OK) {
         goto exit;
@@ -470,17 +501,22 @@ exit:
 }
 
 int gs_init(PSERVER_DATA server, const std::string address, bool skip_https) {
-    if (!CryptoManager::load_cert_key_pair()) {
-        Logger::info("Client", "No certs, generate new...");
+    {
+        static std::mutex init_mutex;
+        std::lock_guard<std::mutex> guard(init_mutex);
         
-        if (!CryptoManager::generate_new_cert_key_pair()) {
-            Logger::info("Client", "Failed to generate certs...");
-            return GS_FAILED;
+        if (!CryptoManager::load_cert_key_pair()) {
+            Logger::info("Client", "No certs, generate new...");
+            
+            if (!CryptoManager::generate_new_cert_key_pair()) {
+                Logger::info("Client", "Failed to generate certs...");
+                return GS_FAILED;
+            }
         }
+        
+        http_init(Settings::instance().key_dir());
     }
     
-    http_init(Settings::instance().key_dir());
-    
     LiInitializeServerInformation(&server->serverInfo);
     server->address = address;
     server->serverInfo.address = server->address.c_str();
@@ -27,6 +27,15 @@
 #define MIN_SUPPORTED_GFE_VERSION 3
 #define MAX_SUPPORTED_GFE_VERSION 7
 
+// Can be overridden at build time to talk to a host on other ports, like a local stand-in server
+#ifndef GAMESTREAM_HTTPS_PORT
+#define GAMESTREAM_HTTPS_PORT 47984
+#endif
+
+#ifndef GAMESTREAM_HTTP_PORT
+#define GAMESTREAM_HTTP_PORT 47989
+#endif
+
 typedef struct _SERVER_DATA {
     std::string address;
     std::string serverInfoAppVersion;
@@ -48,9 +57,9 @@ void gs_set_error(std::string error);
 std::string gs_error();
 
 int gs_init(PSERVER_DATA server, const std::string address, bool skip_https = false);
-int gs_app_boxart(PSERVER_DATA server, int app_id, Data* out);
+int gs_app_boxart(const SERVER_DATA *server, int app_id, Data* out);
 int gs_start_app(PSERVER_DATA server, PSTREAM_CONFIGURATION config, int appId, bool sops, bool localaudio, int gamepad_mask);
-int gs_applist(PSERVER_DATA server, PAPP_LIST *app_list);
-int gs_unpair(PSERVER_DATA server);
+int gs_applist(const SERVER_DATA *server, PAPP_LIST app_list);
+int gs_unpair(const SERVER_DATA *server);
 int gs_pair(PSERVER_DATA server, char* pin);
-int gs_quit_app(PSERVER_DATA server);
+int gs_quit_app(const SERVER_DATA *server);
@@ -26,15 +26,55 @@
 #include <stdbool.h>
 #include <string.h>
 #include <curl/curl.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
 
-static CURL *curl;
+// Keep a few idle handles, concurrent requests are bounded by the task queue workers
+#define HTTP_HANDLE_POOL_SIZE 4
+
+static bool is_initialized = false;
+static std::string certificate_file_path;
+static std::string key_file_path;
+
+// TLS sessions, connections and DNS are shared between all handles,
+// so a request on any handle resumes the session to the same host
+static CURLSH *share;
+static std::mutex share_mutexes[CURL_LOCK_DATA_LAST];
+
+// The pool and the share pointer are guarded by pool_mutex. A reset share is kept
+// until the handles of the requests which were running then are released.
+static std::mutex pool_mutex;
+static std::vector<CURL *> pool;
+static std::vector<CURLSH *> retired_shares;
 
 struct HTTP_DATA {
     char *memory;
     size_t size;
 };
 
-static size_t _write_curl(void *contents, size_t size, size_t nmemb, void *userp) {
+struct HTTP_XML_STREAM {
+    PXML_STREAM stream;
+    size_t size;
+    int status;
+    std::string error;
+};
+
+static size_t _write_xml_stream(char *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+    HTTP_XML_STREAM* xml_stream = (HTTP_XML_STREAM *)userp;
+    
+    xml_stream->status = xml_stream_write(xml_stream->stream, contents, realsize);
+    if (xml_stream->status != GS_OK) {
+        xml_stream->error = gs_error();
+        return 0;
+    }
+    
+    xml_stream->size += realsize;
+    return realsize;
+}
+
+static size_t _write_curl(char *contents, size_t size, size_t nmemb, void *userp) {
     size_t realsize = size * nmemb;
     HTTP_DATA* mem = (HTTP_DATA *)userp;
     
@@ -48,58 +88,163 @@ static size_t _write_curl(void *contents, size_t size, size_t nmemb, void *userp
     return realsize;
 }
 
-int http_init(const std::string key_directory) {
-    if (!curl) {
-        curl_global_init(CURL_GLOBAL_ALL);
-        Logger::info("Curl", "%s", curl_version());
-    } else {
-        return GS_OK;
-    }
-    
-    curl = curl_easy_init();
+static void lock_share(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+    share_mutexes[data].lock();
+}
+
+static void unlock_share(CURL *handle, curl_lock_data data, void *userptr) {
+    share_mutexes[data].unlock();
+}
+
+static CURLSH* create_share() {
+    CURLSH *new_share = curl_share_init();
     
-    if (!curl)
-        return GS_FAILED;
+    if (!new_share)
+        return NULL;
     
-    char certificateFilePath[4096];
-    sprintf(certificateFilePath, "%s/%s", key_directory.c_str(), CERTIFICATE_FILE_NAME);
+    curl_share_setopt(new_share, CURLSHOPT_LOCKFUNC, lock_share);
+    curl_share_setopt(new_share, CURLSHOPT_UNLOCKFUNC, unlock_share);
+    curl_share_setopt(new_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(new_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_share_setopt(new_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    return new_share;
+}
+
+// Fails while a handle is still attached to the share
+static void cleanup_retired_shares() {
+    retired_shares.erase(std::remove_if(retired_shares.begin(), retired_shares.end(), [](CURLSH *retired_share) {
+        return curl_share_cleanup(retired_share) == CURLSHE_OK;
+    }), retired_shares.end());
+}
+
+static CURL* create_handle() {
+    CURL *curl = curl_easy_init();
     
-    char keyFilePath[4096];
-    sprintf(&keyFilePath[0], "%s/%s", key_directory.c_str(), KEY_FILE_NAME);
+    if (!curl)
+        return NULL;
     
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
     curl_easy_setopt(curl, CURLOPT_SSLENGINE_DEFAULT, 1L);
     curl_easy_setopt(curl, CURLOPT_SSLCERTTYPE, "PEM");
-    curl_easy_setopt(curl, CURLOPT_SSLCERT, certificateFilePath);
+    curl_easy_setopt(curl, CURLOPT_SSLCERT, certificate_file_path.c_str());
     curl_easy_setopt(curl, CURLOPT_SSLKEYTYPE, "PEM");
-    curl_easy_setopt(curl, CURLOPT_SSLKEY, keyFilePath);
+    curl_easy_setopt(curl, CURLOPT_SSLKEY, key_file_path.c_str());
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _write_curl);
     curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_SESSIONID_CACHE, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_SESSIONID_CACHE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    return curl;
+}
+
+static CURL* acquire_handle() {
+    std::lock_guard<std::mutex> guard(pool_mutex);
+    
+    if (!pool.empty()) {
+        CURL *curl = pool.back();
+        pool.pop_back();
+        return curl;
+    }
+    return create_handle();
+}
+
+static void release_handle(CURL *curl) {
+    std::lock_guard<std::mutex> guard(pool_mutex);
+    
+    // The handle may be from before a reset, it goes to the current share
+    if (!retired_shares.empty()) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    }
+    
+    if (pool.size() < HTTP_HANDLE_POOL_SIZE) {
+        pool.push_back(curl);
+    } else {
+        curl_easy_cleanup(curl);
+    }
+    
+    cleanup_retired_shares();
+}
+
+int http_init(const std::string key_directory) {
+    if (!is_initialized) {
+        curl_global_init(CURL_GLOBAL_ALL);
+        Logger::info("Curl", "%s", curl_version());
+    } else {
+        return GS_OK;
+    }
+    
+    share = create_share();
+    
+    if (!share)
+        return GS_FAILED;
     
+    certificate_file_path = key_directory + "/" + CERTIFICATE_FILE_NAME;
+    key_file_path = key_directory + "/" + KEY_FILE_NAME;
+    
+    is_initialized = true;
     return GS_OK;
 }
 
-int http_request(const std::string url, Data* data, HTTPRequestTimeout timeout) {
+static void log_request_time(CURL *curl) {
+    // Times are from the start of the request, appconnect is 0 for HTTP and resumed connections
+    double connect_time = 0, appconnect_time = 0, total_time = 0;
+    long new_connections = 0;
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connect_time);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &appconnect_time);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &new_connections);
+    
+    double handshake_time = std::max(connect_time, appconnect_time);
+    double transfer_time = total_time - handshake_time;
+    Logger::info("Curl", "Handshake: %.1f ms (%s), transfer: %.1f ms", handshake_time * 1000, new_connections > 0 ? "new connection" : "reused connection", transfer_time * 1000);
+}
+
+static int perform_request(const std::string &url, curl_write_callback write_function, void *write_data, HTTPRequestTimeout timeout) {
     Logger::info("Curl", "Request:\n%s", url.c_str());
     
-    HTTP_DATA* http_data = (HTTP_DATA*)malloc(sizeof(HTTP_DATA));
-    http_data->memory = (char*)malloc(1);
-    http_data->size = 0;
+    CURL *curl = acquire_handle();
     
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, http_data);
+    if (!curl) {
+        gs_set_error("Failed to create curl handle");
+        return GS_FAILED;
+    }
+    
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_function);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, write_data);
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
     
     CURLcode res = curl_easy_perform(curl);
     
+    if (res == CURLE_OK) {
+        log_request_time(curl);
+    }
+    
+    release_handle(curl);
+    
     if (res != CURLE_OK) {
         gs_set_error(curl_easy_strerror(res));
         Logger::error("Curl", "error: %s", gs_error().c_str());
         return GS_FAILED;
+    }
+    return GS_OK;
+}
+
+int http_request(const std::string url, Data* data, HTTPRequestTimeout timeout) {
+    HTTP_DATA* http_data = (HTTP_DATA*)malloc(sizeof(HTTP_DATA));
+    http_data->memory = (char*)malloc(1);
+    http_data->size = 0;
+    
+    int ret = perform_request(url, _write_curl, http_data, timeout);
+    
+    if (ret != GS_OK) {
+        free(http_data->memory);
+        free(http_data);
+        return ret;
     } else if (http_data->memory == NULL) {
         Logger::error("Curl", "memory = NULL");
+        free(http_data);
         return GS_OUT_OF_MEMORY;
     }
     
@@ -116,6 +261,143 @@ int http_request(const std::string url, Data* data, HTTPRequestTimeout timeout)
     return GS_OK;
 }
 
+int http_request(const std::string url, PXML_STREAM stream, HTTPRequestTimeout timeout) {
+    HTTP_XML_STREAM xml_stream = { stream, 0, GS_OK, "" };
+    
+    int ret = perform_request(url, _write_xml_stream, &xml_stream, timeout);
+    
+    // Report the parser error instead of the write error of curl
+    if (xml_stream.status != GS_OK) {
+        gs_set_error(xml_stream.error);
+        return xml_stream.status;
+    } else if (ret != GS_OK) {
+        return ret;
+    }
+    
+    Logger::info("Curl", "Response: Ok, %zu bytes parsed", xml_stream.size);
+    return GS_OK;
+}
+
+void http_request_concurrent(HTTP_XML_REQUEST *requests, int count, HTTPRequestTimeout timeout, const std::function<bool(int)> &on_finished) {
+    CURLM *multi = curl_multi_init();
+    std::vector<CURL *> handles(count, NULL);
+    std::vector<HTTP_XML_STREAM> xml_streams(count);
+    int active = 0;
+    
+    for (int i = 0; i < count; i++) {
+        Logger::info("Curl", "Request:\n%s", requests[i].url.c_str());
+        
+        requests[i].status = GS_FAILED;
+        requests[i].error = "Request was cancelled";
+        xml_streams[i] = { requests[i].stream, 0, GS_OK, "" };
+        
+        if (!multi || !(handles[i] = acquire_handle())) {
+            requests[i].error = "Failed to create curl handle";
+            continue;
+        }
+        
+        curl_easy_setopt(handles[i], CURLOPT_WRITEFUNCTION, _write_xml_stream);
+        curl_easy_setopt(handles[i], CURLOPT_WRITEDATA, &xml_streams[i]);
+        curl_easy_setopt(handles[i], CURLOPT_URL, requests[i].url.c_str());
+        curl_easy_setopt(handles[i], CURLOPT_TIMEOUT, timeout);
+        curl_easy_setopt(handles[i], CURLOPT_PRIVATE, (void *)(intptr_t)i);
+        curl_multi_add_handle(multi, handles[i]);
+        active++;
+    }
+    
+    bool is_decided = false;
+    
+    while (active > 0 && !is_decided) {
+        int running;
+        curl_multi_perform(multi, &running);
+        
+        CURLMsg *message;
+        int queued;
+        
+        while (!is_decided && (message = curl_multi_info_read(multi, &queued))) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+            
+            char *index_pointer;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &index_pointer);
+            int i = (int)(intptr_t)index_pointer;
+            
+            // Report the parser error instead of the write error of curl
+            if (xml_streams[i].status != GS_OK) {
+                requests[i].status = xml_streams[i].status;
+                requests[i].error = xml_streams[i].error;
+            } else if (message->data.result != CURLE_OK) {
+                requests[i].status = GS_FAILED;
+                requests[i].error = curl_easy_strerror(message->data.result);
+                Logger::error("Curl", "error: %s", requests[i].error.c_str());
+            } else {
+                requests[i].status = GS_OK;
+                requests[i].error = "";
+                log_request_time(handles[i]);
+                Logger::info("Curl", "Response: Ok, %zu bytes parsed", xml_streams[i].size);
+            }
+            
+            curl_multi_remove_handle(multi, handles[i]);
+            release_handle(handles[i]);
+            handles[i] = NULL;
+            active--;
+            
+            is_decided = on_finished(i);
+        }
+        
+        if (active > 0 && !is_decided) {
+            curl_multi_wait(multi, NULL, 0, 100, NULL);
+        }
+    }
+    
+    for (int i = 0; i < count; i++) {
+        if (handles[i]) {
+            Logger::info("Curl", "Cancelled:\n%s", requests[i].url.c_str());
+            curl_multi_remove_handle(multi, handles[i]);
+            release_handle(handles[i]);
+        }
+    }
+    
+    if (multi) {
+        curl_multi_cleanup(multi);
+    }
+}
+
+void http_reset_sessions() {
+    std::lock_guard<std::mutex> guard(pool_mutex);
+    
+    if (!share) {
+        return;
+    }
+    
+    CURLSH *new_share = create_share();
+    
+    if (!new_share) {
+        Logger::error("Curl", "Failed to reset the shared sessions");
+        return;
+    }
+    
+    // Idle handles and their connections go with the old share
+    for (auto curl: pool) {
+        curl_easy_cleanup(curl);
+    }
+    pool.clear();
+    
+    retired_shares.push_back(share);
+    share = new_share;
+    cleanup_retired_shares();
+}
+
 void http_cleanup() {
-    curl_easy_cleanup(curl);
+    std::lock_guard<std::mutex> guard(pool_mutex);
+    
+    for (auto curl: pool) {
+        curl_easy_cleanup(curl);
+    }
+    pool.clear();
+    
+    cleanup_retired_shares();
+    curl_share_cleanup(share);
+    share = NULL;
 }
@@ -18,6 +18,8 @@
  */
 
 #include "Data.hpp"
+#include "xml.h"
+#include <functional>
 #pragma once
 
 enum HTTPRequestTimeout: long {
@@ -27,4 +29,23 @@ enum HTTPRequestTimeout: long {
 };
 
 int http_init(const std::string key_directory);
+
+// Drops the shared TLS sessions and the kept-alive connections, when the host
+// trusts the client certificate differently, after pairing or unpairing
+void http_reset_sessions();
+
 int http_request(const std::string url, Data* data, HTTPRequestTimeout timeout);
+
+// Parses the response while it downloads, the caller finishes or frees the stream
+int http_request(const std::string url, PXML_STREAM stream, HTTPRequestTimeout timeout);
+
+typedef struct _HTTP_XML_REQUEST {
+    std::string url;
+    PXML_STREAM stream;
+    int status;
+    std::string error;
+} HTTP_XML_REQUEST;
+
+// Performs streaming requests at once, on_finished is called for each completed request.
+// When it returns true, the remaining requests are cancelled with GS_FAILED status.
+void http_request_concurrent(HTTP_XML_REQUEST *requests, int count, HTTPRequestTimeout timeout, const std::function<bool(int)> &on_finished);
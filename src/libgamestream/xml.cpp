@@ -23,9 +23,15 @@
 
 #include <expat.h>
 #include <string.h>
+#include <algorithm>
+#include <string>
 
 #define STATUS_OK 200
 
+// Reserved once per a request, enough for most of libraries
+#define APPLIST_RESERVED_APPS 256
+#define APPLIST_RESERVED_NAME_LENGTH 24
+
 struct xml_query {
     char *memory;
     size_t size;
@@ -33,6 +39,20 @@ struct xml_query {
     void* data;
 };
 
+enum applist_field {
+    APPLIST_FIELD_NONE,
+    APPLIST_FIELD_TITLE,
+    APPLIST_FIELD_ID
+};
+
+struct applist_query {
+    PAPP_LIST list;
+    int status;
+    enum applist_field field;
+    char id_text[16];
+    size_t id_length;
+};
+
 static void XMLCALL _xml_start_element(void *userData, const char *name, const char **atts) {
     struct xml_query *search = (struct xml_query*) userData;
     if (strcmp((const char *)search->data, name) == 0) {
@@ -47,89 +67,153 @@ static void XMLCALL _xml_end_element(void *userData, const char *name) {
     }
 }
 
-static void XMLCALL _xml_start_applist_element(void *userData, const char *name, const char **atts) {
-    struct xml_query *search = (struct xml_query*) userData;
-    if (strcmp("App", name) == 0) {
-        PAPP_LIST app = (PAPP_LIST)malloc(sizeof(APP_LIST));
-        if (app == NULL) {
-            return;
+static void XMLCALL _xml_start_status_element(void *userData, const char *name, const char **atts) {
+    if (strcmp("root", name) == 0) {
+        int* status = (int*) userData;
+        for (int i = 0; atts[i]; i += 2) {
+            if (strcmp("status_code", atts[i]) == 0) {
+                *status = atoi(atts[i + 1]);
+            } else if (*status != STATUS_OK && strcmp("status_message", atts[i]) == 0) {
+                gs_set_error(atts[i + 1]);
+            }
         }
-        
-        app->id = 0;
-        app->name = NULL;
-        app->next = (PAPP_LIST) search->data;
-        search->data = app;
-    } else if (strcmp("ID", name) == 0 || strcmp("AppTitle", name) == 0) {
-        search->memory = (char *)malloc(1);
-        search->size = 0;
-        search->start = 1;
+    }
+}
+
+static void XMLCALL _xml_end_status_element(void *userData, const char *name) { }
+
+// Titles are appended to the names arena, no allocation per an app
+static void XMLCALL _xml_start_applist_element(void *userData, const char *name, const char **atts) {
+    struct applist_query *query = (struct applist_query*) userData;
+    PAPP_LIST list = query->list;
+    
+    if (strcmp("root", name) == 0) {
+        _xml_start_status_element(&query->status, name, atts);
+    } else if (strcmp("App", name) == 0) {
+        list->apps.push_back({ list->names.size(), 0, 0 });
+    } else if (list->apps.empty()) {
+        return;
+    } else if (strcmp("AppTitle", name) == 0) {
+        list->apps.back().name_offset = list->names.size();
+        list->apps.back().name_length = 0;
+        query->field = APPLIST_FIELD_TITLE;
+    } else if (strcmp("ID", name) == 0) {
+        query->id_length = 0;
+        query->field = APPLIST_FIELD_ID;
     }
 }
 
 static void XMLCALL _xml_end_applist_element(void *userData, const char *name) {
-    struct xml_query *search = (struct xml_query*) userData;
-    if (search->start) {
-        PAPP_LIST list = (PAPP_LIST) search->data;
-        if (list == NULL)
-            return;
-        
-        if (strcmp("ID", name) == 0) {
-            list->id = atoi(search->memory);
-            free(search->memory);
-        } else if (strcmp("AppTitle", name) == 0) {
-            list->name = search->memory;
-        }
-        search->start = 0;
+    struct applist_query *query = (struct applist_query*) userData;
+    
+    if (query->field == APPLIST_FIELD_ID) {
+        query->id_text[query->id_length] = 0;
+        query->list->apps.back().id = atoi(query->id_text);
     }
+    query->field = APPLIST_FIELD_NONE;
 }
 
-static void XMLCALL _xml_start_mode_element(void *userData, const char *name, const char **atts) {
-    struct xml_query *search = (struct xml_query*) userData;
-    if (strcmp("DisplayMode", name) == 0) {
+static void XMLCALL _xml_write_applist_data(void *userData, const XML_Char *s, int len) {
+    struct applist_query *query = (struct applist_query*) userData;
+    
+    if (query->field == APPLIST_FIELD_TITLE) {
+        query->list->names.append(s, len);
+        query->list->apps.back().name_length += len;
+    } else if (query->field == APPLIST_FIELD_ID) {
+        size_t length = std::min((size_t)len, sizeof(query->id_text) - 1 - query->id_length);
+        memcpy(query->id_text + query->id_length, s, length);
+        query->id_length += length;
+    }
+}
+
+struct serverinfo_query {
+    PSERVER_INFO_XML info;
+    int status;
+    std::string* field;
+    int field_depth;
+    std::string text;
+};
+
+struct _XML_STREAM {
+    XML_Parser parser;
+    struct applist_query applist_query;
+    struct serverinfo_query serverinfo_query;
+};
+
+static std::string* serverinfo_field(PSERVER_INFO_XML info, const char *name) {
+    if (strcmp("currentgame", name) == 0) {
+        return &info->currentGame;
+    } else if (strcmp("PairStatus", name) == 0) {
+        return &info->pairStatus;
+    } else if (strcmp("appversion", name) == 0) {
+        return &info->appVersion;
+    } else if (strcmp("state", name) == 0) {
+        return &info->state;
+    } else if (strcmp("ServerCodecModeSupport", name) == 0) {
+        return &info->serverCodecModeSupport;
+    } else if (strcmp("gputype", name) == 0) {
+        return &info->gpuType;
+    } else if (strcmp("GsVersion", name) == 0) {
+        return &info->gsVersion;
+    } else if (strcmp("hostname", name) == 0) {
+        return &info->hostname;
+    } else if (strcmp("GfeVersion", name) == 0) {
+        return &info->gfeVersion;
+    } else if (strcmp("mac", name) == 0) {
+        return &info->mac;
+    }
+    return NULL;
+}
+
+static void XMLCALL _xml_start_serverinfo_element(void *userData, const char *name, const char **atts) {
+    struct serverinfo_query *query = (struct serverinfo_query*) userData;
+    
+    if (strcmp("root", name) == 0) {
+        _xml_start_status_element(&query->status, name, atts);
+    } else if (strcmp("DisplayMode", name) == 0) {
         PDISPLAY_MODE mode = (PDISPLAY_MODE)calloc(1, sizeof(DISPLAY_MODE));
         if (mode != NULL) {
-            mode->next = (PDISPLAY_MODE) search->data;
-            search->data = mode;
+            mode->next = query->info->modes;
+            query->info->modes = mode;
         }
-    } else if (search->data != NULL && (strcmp("Height", name) == 0 || strcmp("Width", name) == 0 || strcmp("RefreshRate", name) == 0)) {
-        search->memory = (char *)malloc(1);
-        search->size = 0;
-        search->start = 1;
+    } else if (query->info->modes != NULL && (strcmp("Height", name) == 0 || strcmp("Width", name) == 0 || strcmp("RefreshRate", name) == 0)) {
+        query->text.clear();
+        query->field = &query->text;
+        query->field_depth = 1;
+    } else if (query->field_depth > 0) {
+        query->field_depth++;
+    } else if ((query->field = serverinfo_field(query->info, name)) != NULL) {
+        query->field_depth = 1;
     }
 }
 
-static void XMLCALL _xml_end_mode_element(void *userData, const char *name) {
-    struct xml_query *search = (struct xml_query*) userData;
-    if (search->data != NULL && search->start) {
-        PDISPLAY_MODE mode = (PDISPLAY_MODE) search->data;
+static void XMLCALL _xml_end_serverinfo_element(void *userData, const char *name) {
+    struct serverinfo_query *query = (struct serverinfo_query*) userData;
+    
+    if (query->field_depth == 0 || --query->field_depth > 0) {
+        return;
+    }
+    
+    if (query->field == &query->text) {
+        PDISPLAY_MODE mode = query->info->modes;
         if (strcmp("Width", name) == 0) {
-            mode->width = atoi(search->memory);
+            mode->width = atoi(query->text.c_str());
         } else if (strcmp("Height", name) == 0) {
-            mode->height = atoi(search->memory);
+            mode->height = atoi(query->text.c_str());
         } else if (strcmp("RefreshRate", name) == 0) {
-            mode->refresh = atoi(search->memory);
+            mode->refresh = atoi(query->text.c_str());
         }
-        
-        free(search->memory);
-        search->start = 0;
     }
+    query->field = NULL;
 }
 
-static void XMLCALL _xml_start_status_element(void *userData, const char *name, const char **atts) {
-    if (strcmp("root", name) == 0) {
-        int* status = (int*) userData;
-        for (int i = 0; atts[i]; i += 2) {
-            if (strcmp("status_code", atts[i]) == 0) {
-                *status = atoi(atts[i + 1]);
-            } else if (*status != STATUS_OK && strcmp("status_message", atts[i]) == 0) {
-                gs_set_error(strdup(atts[i + 1]));
-            }
-        }
+static void XMLCALL _xml_write_serverinfo_data(void *userData, const XML_Char *s, int len) {
+    struct serverinfo_query *query = (struct serverinfo_query*) userData;
+    if (query->field != NULL) {
+        query->field->append(s, len);
     }
 }
 
-static void XMLCALL _xml_end_status_element(void *userData, const char *name) { }
-
 static void XMLCALL _xml_write_data(void *userData, const XML_Char *s, int len) {
     struct xml_query *search = (struct xml_query*) userData;
     if (search->start > 0) {
@@ -172,49 +256,73 @@ int xml_search(const Data& data, const std::string node, std::string* result) {
     return GS_OK;
 }
 
-int xml_applist(const Data& data, PAPP_LIST *app_list) {
-    struct xml_query query;
-    query.memory = (char *)calloc(1, 1);
-    query.size = 0;
-    query.start = 0;
-    query.data = NULL;
+// The stream is zero initialized, the handlers get a query inside it
+static void xml_stream_init_parser(PXML_STREAM stream, void *user_data, XML_StartElementHandler start, XML_EndElementHandler end, XML_CharacterDataHandler character_data) {
+    stream->parser = XML_ParserCreate("UTF-8");
+    XML_SetUserData(stream->parser, user_data);
+    XML_SetElementHandler(stream->parser, start, end);
+    XML_SetCharacterDataHandler(stream->parser, character_data);
+}
+
+PXML_STREAM xml_applist_stream(PAPP_LIST app_list) {
+    PXML_STREAM stream = new XML_STREAM();
+    stream->applist_query.list = app_list;
     
-    XML_Parser parser = XML_ParserCreate("UTF-8");
-    XML_SetUserData(parser, &query);
-    XML_SetElementHandler(parser, _xml_start_applist_element, _xml_end_applist_element);
-    XML_SetCharacterDataHandler(parser, _xml_write_data);
+    app_list->apps.clear();
+    app_list->names.clear();
+    app_list->apps.reserve(APPLIST_RESERVED_APPS);
+    app_list->names.reserve(APPLIST_RESERVED_APPS * APPLIST_RESERVED_NAME_LENGTH);
     
-    if (!XML_Parse(parser, (const char *)data.bytes(), (int)data.size(), 1)) {
-        XML_Error code = XML_GetErrorCode(parser);
+    xml_stream_init_parser(stream, &stream->applist_query, _xml_start_applist_element, _xml_end_applist_element, _xml_write_applist_data);
+    return stream;
+}
+
+PXML_STREAM xml_serverinfo_stream(PSERVER_INFO_XML info) {
+    PXML_STREAM stream = new XML_STREAM();
+    stream->serverinfo_query.info = info;
+    info->modes = NULL;
+    xml_stream_init_parser(stream, &stream->serverinfo_query, _xml_start_serverinfo_element, _xml_end_serverinfo_element, _xml_write_serverinfo_data);
+    return stream;
+}
+
+int xml_stream_write(PXML_STREAM stream, const char *data, size_t size) {
+    if (!XML_Parse(stream->parser, data, (int)size, 0)) {
+        XML_Error code = XML_GetErrorCode(stream->parser);
         gs_set_error(XML_ErrorString(code));
-        XML_ParserFree(parser);
         return GS_INVALID;
     }
-    
-    XML_ParserFree(parser);
-    *app_list = (PAPP_LIST) query.data;
     return GS_OK;
 }
 
-int xml_modelist(const Data& data, PDISPLAY_MODE *mode_list) {
-    struct xml_query query = {0};
-    query.memory = (char *)calloc(1, 1);
-    XML_Parser parser = XML_ParserCreate("UTF-8");
-    XML_SetUserData(parser, &query);
-    XML_SetElementHandler(parser, _xml_start_mode_element, _xml_end_mode_element);
-    XML_SetCharacterDataHandler(parser, _xml_write_data);
-    
-    if (!XML_Parse(parser, (const char *)data.bytes(), (int)data.size(), 1)) {
-        XML_Error code = XML_GetErrorCode(parser);
+int xml_stream_finish(PXML_STREAM stream) {
+    if (!XML_Parse(stream->parser, NULL, 0, 1)) {
+        XML_Error code = XML_GetErrorCode(stream->parser);
         gs_set_error(XML_ErrorString(code));
-        XML_ParserFree(parser);
+        xml_stream_free(stream);
         return GS_INVALID;
     }
     
-    XML_ParserFree(parser);
-    *mode_list = (PDISPLAY_MODE) query.data;
+    int status = stream->applist_query.list ? stream->applist_query.status : stream->serverinfo_query.status;
+    
+    if (status != STATUS_OK) {
+        xml_stream_free(stream);
+        return GS_ERROR;
+    }
+    
+    XML_ParserFree(stream->parser);
+    delete stream;
     return GS_OK;
+}
+
+void xml_stream_free(PXML_STREAM stream) {
+    // Don't hand out a partial list after an error
+    if (stream->applist_query.list) {
+        stream->applist_query.list->apps.clear();
+        stream->applist_query.list->names.clear();
+    }
     
+    XML_ParserFree(stream->parser);
+    delete stream;
 }
 
 int xml_status(const Data& data) {
@@ -18,12 +18,20 @@
  */
 
 #include "Data.hpp"
+#include <string>
+#include <vector>
 #pragma once
 
-typedef struct _APP_LIST {
-  char* name;
+typedef struct _APP_LIST_ENTRY {
+  size_t name_offset;
+  size_t name_length;
   int id;
-  struct _APP_LIST *next;
+} APP_LIST_ENTRY;
+
+// All titles are stored one after another in names, an entry points into it
+typedef struct _APP_LIST {
+  std::string names;
+  std::vector<APP_LIST_ENTRY> apps;
 } APP_LIST, *PAPP_LIST;
 
 typedef struct _DISPLAY_MODE {
@@ -33,7 +41,30 @@ typedef struct _DISPLAY_MODE {
   struct _DISPLAY_MODE *next;
 } DISPLAY_MODE, *PDISPLAY_MODE;
 
+typedef struct _SERVER_INFO_XML {
+  std::string currentGame;
+  std::string pairStatus;
+  std::string appVersion;
+  std::string state;
+  std::string serverCodecModeSupport;
+  std::string gpuType;
+  std::string gsVersion;
+  std::string hostname;
+  std::string gfeVersion;
+  std::string mac;
+  PDISPLAY_MODE modes;
+} SERVER_INFO_XML, *PSERVER_INFO_XML;
+
+// Incremental parser, fed by chunks while a response downloads
+typedef struct _XML_STREAM XML_STREAM, *PXML_STREAM;
+
 int xml_search(const Data& data, const std::string node, std::string* result);
-int xml_applist(const Data& data, PAPP_LIST *app_list);
-int xml_modelist(const Data& data, PDISPLAY_MODE *mode_list);
 int xml_status(const Data& data);
+
+PXML_STREAM xml_applist_stream(PAPP_LIST app_list);
+PXML_STREAM xml_serverinfo_stream(PSERVER_INFO_XML info);
+int xml_stream_write(PXML_STREAM stream, const char *data, size_t size);
+
+// Both free the stream, finish returns GS_ERROR for a failed status_code
+int xml_stream_finish(PXML_STREAM stream);
+void xml_stream_free(PXML_STREAM stream);
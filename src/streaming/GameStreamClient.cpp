@@ -1,9 +1,13 @@
 #include "GameStreamClient.hpp"
 #include "Settings.hpp"
 #include "WakeOnLanManager.hpp"
-#include <thread>
-#include <mutex>
+#include "HostScanner.hpp"
+#include "MdnsDiscovery.hpp"
+#include "TaskQueue.hpp"
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -12,68 +16,61 @@
 #include <unistd.h>
 #include <switch.h>
 
-static std::mutex m_async_mutex;
-static std::vector<std::function<void()>> m_tasks;
+#define MDNS_DISCOVERY_TIMEOUT_MS 1000
 
-static volatile bool task_loop_active = true;
+#define TASK_QUEUE_WORKER_COUNT 3
 
-static void task_loop() {
-    while (task_loop_active) {
-        std::vector<std::function<void()>> m_tasks_copy; {
-            std::lock_guard<std::mutex> guard(m_async_mutex);
-            m_tasks_copy = m_tasks;
-            m_tasks.clear();
-        }
-        
-        for (auto task: m_tasks_copy) {
-            task();
-        }
-        
-        usleep(500'000);
-    }
+static void perform_async(TaskPriority priority, const char* name, const std::function<void()> &task) {
+    TaskQueue::instance().push(priority, name, task);
 }
 
-#ifdef __SWITCH__
-static Thread task_loop_thread;
-static void start_task_loop() {
-    threadCreate(
-        &task_loop_thread,
-        [](void* a) {
-            task_loop();
-        },
-        NULL,
-        NULL,
-        0x10000,
-        0x2C,
-        -2
-    );
-    threadStart(&task_loop_thread);
+void GameStreamClient::start() {
+    TaskQueue::instance().start(TASK_QUEUE_WORKER_COUNT);
 }
-#else
-static void start_task_loop() {
-    auto thread = std::thread([](){
-        task_loop();
-    });
-    thread.detach();
+
+void GameStreamClient::stop() {
+    TaskQueue::instance().stop();
 }
-#endif
 
-void perform_async(std::function<void()> task) {
-    std::lock_guard<std::mutex> guard(m_async_mutex);
-    m_tasks.push_back(task);
+std::shared_ptr<const SERVER_DATA> GameStreamClient::server_data(const std::string &address) {
+    std::lock_guard<std::mutex> guard(m_server_data_mutex);
+    
+    auto it = m_server_data.find(address);
+    return it != m_server_data.end() ? it->second : nullptr;
 }
 
-void GameStreamClient::start() {
-    start_task_loop();
+static std::shared_ptr<SERVER_DATA> copy_snapshot(const SERVER_DATA &snapshot) {
+    auto copy = std::make_shared<SERVER_DATA>(snapshot);
+    
+    // SERVER_INFORMATION points into the own strings
+    copy->serverInfo.address = copy->address.c_str();
+    copy->serverInfo.serverInfoAppVersion = copy->serverInfoAppVersion.c_str();
+    copy->serverInfo.serverInfoGfeVersion = copy->serverInfoGfeVersion.c_str();
+    return copy;
 }
 
-void GameStreamClient::stop() {
-    task_loop_active = false;
+std::shared_ptr<SERVER_DATA> GameStreamClient::copy_server_data(const std::string &address) {
+    auto snapshot = server_data(address);
+    return snapshot ? copy_snapshot(*snapshot) : nullptr;
+}
+
+void GameStreamClient::publish_server_data(const std::string &address, std::shared_ptr<const SERVER_DATA> server_data) {
+    std::lock_guard<std::mutex> guard(m_server_data_mutex);
+    m_server_data[address] = server_data;
+}
+
+void GameStreamClient::update_server_data(const std::string &address, const std::function<void(SERVER_DATA *)> &update) {
+    std::lock_guard<std::mutex> guard(m_server_data_mutex);
+    
+    // A connect() may have published a newer snapshot while the request ran
+    auto it = m_server_data.find(address);
+    if (it == m_server_data.end()) {
+        return;
+    }
     
-    #ifdef __SWITCH__
-    threadWaitForExit(&task_loop_thread);
-    threadClose(&task_loop_thread);
-    #endif
+    auto copy = copy_snapshot(*it->second);
+    update(copy.get());
+    it->second = copy;
 }
 
 std::vector<std::string> GameStreamClient::host_addresses_for_find() {
@@ -97,40 +94,101 @@ std::vector<std::string> GameStreamClient::host_addresses_for_find() {
     return addresses;
 }
 
-void GameStreamClient::find_host(ServerCallback<Host> callback) {
-    perform_async([this, callback] {
-        auto addresses = host_addresses_for_find();
-        
-        if (addresses.empty()) {
-            nanogui::async([callback] { callback(GSResult<Host>::failure("Can't obtain IP address...")); });
+// A find_host run: the mDNS discovery and the port sweep run at once, serverinfo probes
+// of the found addresses run on the task queue, the last one to finish calls the completion
+struct HostSearch {
+    std::function<void(GSResult<Host>)> callback;
+    std::function<void(GSResult<int>)> completion;
+    // The sweep and the discovery hold one each, until they queued all of their probes
+    std::atomic<int> pending = {2};
+    std::atomic<int> found = {0};
+    
+    // A host found by both is probed once
+    std::mutex probed_mutex;
+    std::set<std::string> probed;
+};
+
+static void finish_host_search(std::shared_ptr<HostSearch> search) {
+    if (--search->pending > 0) {
+        return;
+    }
+    
+    int found = search->found;
+    auto completion = search->completion;
+    
+    nanogui::async([completion, found] {
+        if (found > 0) {
+            completion(GSResult<int>::success(found));
         } else {
-            bool found = false;
+            completion(GSResult<int>::failure("Host PC not found..."));
+        }
+    });
+}
+
+static void probe_host(std::shared_ptr<HostSearch> search, const std::string &address) {
+    {
+        std::lock_guard<std::mutex> guard(search->probed_mutex);
+        
+        if (!search->probed.insert(address).second) {
+            return;
+        }
+    }
+    
+    search->pending++;
+    
+    perform_async(TaskPriority::ServerInfo, "probe_host", [search, address] {
+        SERVER_DATA server_data;
+        
+        if (gs_init(&server_data, address, true) == GS_OK) {
+            search->found++;
             
-            for (int i = 0; i < addresses.size(); i++) {
-                SERVER_DATA server_data;
-                
-                int status = gs_init(&server_data, addresses[i], true);
-                if (status == GS_OK) {
-                    found = true;
-                    
-                    Host host;
-                    host.address = addresses[i];
-                    host.hostname = server_data.hostname;
-                    host.mac = server_data.mac;
-                    nanogui::async([callback, host] { callback(GSResult<Host>::success(host)); });
-                    break;
-                }
-            }
+            Host host;
+            host.address = address;
+            host.hostname = server_data.hostname;
+            host.mac = server_data.mac;
             
-            if (!found) {
-                nanogui::async([callback] { callback(GSResult<Host>::failure("Host PC not found...")); });
-            }
+            auto callback = search->callback;
+            nanogui::async([callback, host] { callback(GSResult<Host>::success(host)); });
+        }
+        
+        finish_host_search(search);
+    });
+}
+
+void GameStreamClient::find_host(ServerCallback<Host> callback, ServerCallback<int> completion) {
+    perform_async(TaskPriority::ServerInfo, "find_host", [this, callback, completion] {
+        auto addresses = host_addresses_for_find();
+        
+        if (addresses.empty()) {
+            nanogui::async([completion] { completion(GSResult<int>::failure("Can't obtain IP address...")); });
+            return;
         }
+        
+        auto search = std::make_shared<HostSearch>();
+        search->callback = callback;
+        search->completion = completion;
+        
+        // Hosts which answer DNS-SD are probed as their answers arrive, while the sweep runs
+        perform_async(TaskPriority::ServerInfo, "discover_mdns_hosts", [search] {
+            discover_mdns_hosts(MDNS_DISCOVERY_TIMEOUT_MS, [&search](const std::string &address) {
+                probe_host(search, address);
+            });
+            
+            finish_host_search(search);
+        });
+        
+        // Only addresses with the open GameStream port get the full serverinfo request,
+        // on the other workers, so the sweep's connect window isn't stalled by them
+        scan_open_hosts(addresses, GAMESTREAM_HTTP_PORT, [&search](const std::string &address) {
+            probe_host(search, address);
+        });
+        
+        finish_host_search(search);
     });
 }
 
 void GameStreamClient::wake_up_host(const Host &host, ServerCallback<bool> callback) {
-    perform_async([this, host, callback] {
+    perform_async(TaskPriority::ServerInfo, "wake_up_host", [this, host, callback] {
         if (WakeOnLanManager::instance().wake_up_host(host)) {
             usleep(5'000'000);
             nanogui::async([callback] { callback(GSResult<bool>::success(true)); });
@@ -141,132 +199,159 @@ void GameStreamClient::wake_up_host(const Host &host, ServerCallback<bool> callb
 }
 
 void GameStreamClient::connect(const std::string &address, ServerCallback<SERVER_DATA> callback) {
-    m_server_data[address] = SERVER_DATA();
-    
-    perform_async([this, address, callback] {
-        int status = gs_init(&m_server_data[address], address);
+    perform_async(TaskPriority::ServerInfo, "connect", [this, address, callback] {
+        auto server_data = std::make_shared<SERVER_DATA>();
+        int status = gs_init(server_data.get(), address);
+        
+        // A failed request leaves a partial server data, the last good one stays
+        if (status == GS_OK) {
+            publish_server_data(address, server_data);
+        }
+        
+        std::string error = gs_error();
         
-        nanogui::async([this, address, callback, status] {
+        nanogui::async([address, callback, status, error, server_data] {
             if (status == GS_OK) {
                 Host host;
                 host.address = address;
-                host.hostname = m_server_data[address].hostname;
-                host.mac = m_server_data[address].mac;
+                host.hostname = server_data->hostname;
+                host.mac = server_data->mac;
                 Settings::instance().add_host(host);
-                callback(GSResult<SERVER_DATA>::success(m_server_data[address]));
+                callback(GSResult<SERVER_DATA>::success(*server_data));
             } else {
-                callback(GSResult<SERVER_DATA>::failure(gs_error()));
+                callback(GSResult<SERVER_DATA>::failure(error));
             }
         });
     });
 }
 
 void GameStreamClient::pair(const std::string &address, const std::string &pin, ServerCallback<bool> callback) {
-    if (m_server_data.count(address) == 0) {
+    auto server_data = copy_server_data(address);
+    
+    if (!server_data) {
         callback(GSResult<bool>::failure("Firstly call connect()..."));
         return;
     }
     
-    perform_async([this, address, pin, callback] {
-        int status = gs_pair(&m_server_data[address], (char *)pin.c_str());
+    perform_async(TaskPriority::ServerInfo, "pair", [this, address, server_data, pin, callback] {
+        int status = gs_pair(server_data.get(), (char *)pin.c_str());
+        
+        if (status == GS_OK) {
+            update_server_data(address, [](SERVER_DATA *server_data) {
+                server_data->paired = true;
+            });
+        }
         
-        nanogui::async([callback, status] {
+        std::string error = gs_error();
+        
+        nanogui::async([callback, status, error] {
             if (status == GS_OK) {
                 callback(GSResult<bool>::success(true));
             } else {
-                callback(GSResult<bool>::failure(gs_error()));
+                callback(GSResult<bool>::failure(error));
             }
         });
     });
 }
 
 void GameStreamClient::applist(const std::string &address, ServerCallback<AppInfoList> callback) {
-    if (m_server_data.count(address) == 0) {
+    auto server_data = this->server_data(address);
+    
+    if (!server_data) {
         callback(GSResult<AppInfoList>::failure("Firstly call connect() & pair()..."));
         return;
     }
     
-    perform_async([this, address, callback] {
-        PAPP_LIST list;
-        
-        int status = gs_applist(&m_server_data[address], &list);
+    perform_async(TaskPriority::AppList, "applist", [server_data, callback] {
+        APP_LIST list;
         
-        AppInfoList app_list;
-        
-        while (list) {
-            app_list.push_back({ .name = list->name, .app_id = list->id });
-            list = list->next;
-        }
+        int status = gs_applist(server_data.get(), &list);
+        AppInfoList app_list(std::move(list));
         
-        std::sort(app_list.begin(), app_list.end(), [](AppInfo a, AppInfo b) { return a.name < b.name; });
+        std::string error = gs_error();
         
-        nanogui::async([this, app_list, callback, status] {
+        nanogui::async([app_list = std::move(app_list), callback, status, error] {
             if (status == GS_OK) {
                 callback(GSResult<AppInfoList>::success(app_list));
             } else {
-                callback(GSResult<AppInfoList>::failure(gs_error()));
+                callback(GSResult<AppInfoList>::failure(error));
             }
         });
     });
 }
 
 void GameStreamClient::app_boxart(const std::string &address, int app_id, ServerCallback<Data> callback) {
-    if (m_server_data.count(address) == 0) {
+    auto server_data = this->server_data(address);
+    
+    if (!server_data) {
         callback(GSResult<Data>::failure("Firstly call connect() & pair()..."));
         return;
     }
     
-    perform_async([this, address, app_id, callback] {
+    perform_async(TaskPriority::BoxArt, "app_boxart", [server_data, app_id, callback] {
         Data data;
-        int status = gs_app_boxart(&m_server_data[address], app_id, &data);
+        int status = gs_app_boxart(server_data.get(), app_id, &data);
+        
+        std::string error = gs_error();
         
-        nanogui::async([this, callback, data, status] {
+        nanogui::async([callback, data, status, error] {
             if (status == GS_OK) {
                 callback(GSResult<Data>::success(data));
             } else {
-                callback(GSResult<Data>::failure(gs_error()));
+                callback(GSResult<Data>::failure(error));
             }
         });
     });
 }
 
 void GameStreamClient::start(const std::string &address, STREAM_CONFIGURATION config, int app_id, ServerCallback<STREAM_CONFIGURATION> callback) {
-    if (m_server_data.count(address) == 0) {
+    auto server_data = copy_server_data(address);
+    
+    if (!server_data) {
         callback(GSResult<STREAM_CONFIGURATION>::failure("Firstly call connect() & pair()..."));
         return;
     }
     
-    m_config = config;
-    
-    perform_async([this, address, app_id, callback] {
-        int status = gs_start_app(&m_server_data[address], &m_config, app_id, Settings::instance().sops(), Settings::instance().play_audio(), 0x1);
+    perform_async(TaskPriority::Launch, "start", [this, address, server_data, config, app_id, callback] {
+        STREAM_CONFIGURATION stream_config = config;
+        int status = gs_start_app(server_data.get(), &stream_config, app_id, Settings::instance().sops(), Settings::instance().play_audio(), 0x1);
+        
+        if (status == GS_OK) {
+            update_server_data(address, [app_id](SERVER_DATA *server_data) {
+                server_data->currentGame = app_id;
+            });
+        }
+        
+        std::string error = gs_error();
         
-        nanogui::async([this, callback, status] {
+        nanogui::async([callback, stream_config, status, error] {
             if (status == GS_OK) {
-                callback(GSResult<STREAM_CONFIGURATION>::success(m_config));
+                callback(GSResult<STREAM_CONFIGURATION>::success(stream_config));
             } else {
-                callback(GSResult<STREAM_CONFIGURATION>::failure(gs_error()));
+                callback(GSResult<STREAM_CONFIGURATION>::failure(error));
             }
         });
     });
 }
 
 void GameStreamClient::quit(const std::string &address, ServerCallback<bool> callback) {
-    if (m_server_data.count(address) == 0) {
+    auto server_data = this->server_data(address);
+    
+    if (!server_data) {
         callback(GSResult<bool>::failure("Firstly call connect() & pair()..."));
         return;
     }
     
-    auto server_data = m_server_data[address];
-    
-    perform_async([this, server_data, callback] {
-        int status = gs_quit_app((PSERVER_DATA)&server_data);
+    perform_async(TaskPriority::Launch, "quit", [server_data, callback] {
+        int status = gs_quit_app(server_data.get());
+        
+        std::string error = gs_error();
         
-        nanogui::async([this, callback, status] {
+        nanogui::async([callback, status, error] {
             if (status == GS_OK) {
                 callback(GSResult<bool>::success(true));
             } else {
-                callback(GSResult<bool>::failure(gs_error()));
+                callback(GSResult<bool>::failure(error));
             }
         });
     });
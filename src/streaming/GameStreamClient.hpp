@@ -1,8 +1,12 @@
 #include "Singleton.hpp"
+#include <algorithm>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include "client.h"
 #include "errors.h"
 #include "Data.hpp"
@@ -50,24 +54,59 @@ template<class T> using ServerCallback = const std::function<void(GSResult<T>)>;
 
 struct Host;
 
+// name points into the titles of the list which it came from
 struct AppInfo {
-    std::string name;
+    std::string_view name;
     int app_id;
 };
 
-using AppInfoList = std::vector<AppInfo>;
+// Sorted by name. Takes over the title arena of gs_applist, copies of the list share it.
+struct AppInfoList {
+public:
+    AppInfoList() {}
+    
+    AppInfoList(APP_LIST &&list) {
+        std::sort(list.apps.begin(), list.apps.end(), [&list](const APP_LIST_ENTRY &a, const APP_LIST_ENTRY &b) {
+            return list.names.compare(a.name_offset, a.name_length, list.names, b.name_offset, b.name_length) < 0;
+        });
+        
+        names = std::make_shared<const std::string>(std::move(list.names));
+        apps.reserve(list.apps.size());
+        
+        for (auto &app: list.apps) {
+            apps.push_back({ .name = std::string_view(*names).substr(app.name_offset, app.name_length), .app_id = app.id });
+        }
+    }
+    
+    std::vector<AppInfo>::const_iterator begin() const {
+        return apps.begin();
+    }
+    
+    std::vector<AppInfo>::const_iterator end() const {
+        return apps.end();
+    }
+    
+    size_t size() const {
+        return apps.size();
+    }
+    
+    // Holds the titles as long as an AppInfo of the list is in use
+    std::shared_ptr<const std::string> names;
+    std::vector<AppInfo> apps;
+};
 
 class GameStreamClient: public Singleton<GameStreamClient> {
 public:
-    SERVER_DATA server_data(const std::string &address) {
-        return m_server_data[address];
-    }
+    // An immutable snapshot, nullptr if connect() wasn't called for the address
+    std::shared_ptr<const SERVER_DATA> server_data(const std::string &address);
     
     void start();
     void stop();
     
     std::vector<std::string> host_addresses_for_find();
-    void find_host(ServerCallback<Host> callback);
+    
+    // callback is called for every found host, completion once the scan is finished
+    void find_host(ServerCallback<Host> callback, ServerCallback<int> completion);
     void wake_up_host(const Host &host, ServerCallback<bool> callback);
     void connect(const std::string &address, ServerCallback<SERVER_DATA> callback);
     void pair(const std::string &address, const std::string &pin, ServerCallback<bool> callback);
@@ -77,6 +116,12 @@ public:
     void quit(const std::string &address, ServerCallback<bool> callback);
     
 private:
-    std::map<std::string, SERVER_DATA> m_server_data;
-    STREAM_CONFIGURATION m_config;
+    // gs_* functions which change the server data work on own copy, then publish their
+    // changes with update_server_data, onto the snapshot which is current by then
+    std::shared_ptr<SERVER_DATA> copy_server_data(const std::string &address);
+    void publish_server_data(const std::string &address, std::shared_ptr<const SERVER_DATA> server_data);
+    void update_server_data(const std::string &address, const std::function<void(SERVER_DATA *)> &update);
+    
+    std::mutex m_server_data_mutex;
+    std::map<std::string, std::shared_ptr<const SERVER_DATA>> m_server_data;
 };
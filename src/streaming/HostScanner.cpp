@@ -0,0 +1,144 @@
+#include "HostScanner.hpp"
+#include "Logger.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+// The Switch BSD service has a small socket limit, curl needs some too
+#define HOST_SCANNER_MAX_PROBES 32
+
+// Unused LAN addresses never answer, a live host answers in a few ms
+#define HOST_SCANNER_CONNECT_TIMEOUT_MS 500
+
+struct Probe {
+    int socket;
+    size_t address_index;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+static int start_probe(const std::string &address, unsigned short port, bool *is_connected) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        return -1;
+    }
+    
+    int probe_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (probe_socket < 0) {
+        Logger::error("HostScanner", "Failed to create socket: %d", errno);
+        return -1;
+    }
+    
+    int flags = fcntl(probe_socket, F_GETFL, 0);
+    fcntl(probe_socket, F_SETFL, flags | O_NONBLOCK);
+    
+    *is_connected = false;
+    
+    if (connect(probe_socket, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        *is_connected = true;
+    } else if (errno != EINPROGRESS) {
+        close(probe_socket);
+        return -1;
+    }
+    return probe_socket;
+}
+
+static bool probe_is_connected(int probe_socket) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    
+    if (getsockopt(probe_socket, SOL_SOCKET, SO_ERROR, &error, &length) != 0) {
+        return false;
+    }
+    return error == 0;
+}
+
+void scan_open_hosts(const std::vector<std::string> &addresses, unsigned short port, const std::function<void(const std::string&)> &on_found) {
+    auto start = std::chrono::steady_clock::now();
+    
+    size_t found = 0;
+    std::vector<Probe> probes;
+    std::vector<struct pollfd> fds;
+    size_t next_address = 0;
+    
+    while (next_address < addresses.size() || !probes.empty()) {
+        // Keep the window full
+        while (next_address < addresses.size() && probes.size() < HOST_SCANNER_MAX_PROBES) {
+            size_t index = next_address++;
+            bool is_connected;
+            int probe_socket = start_probe(addresses[index], port, &is_connected);
+            
+            if (probe_socket < 0) {
+                continue;
+            }
+            
+            if (is_connected) {
+                close(probe_socket);
+                found++;
+                on_found(addresses[index]);
+                continue;
+            }
+            
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(HOST_SCANNER_CONNECT_TIMEOUT_MS);
+            probes.push_back({ probe_socket, index, deadline });
+        }
+        
+        if (probes.empty()) {
+            break;
+        }
+        
+        auto now = std::chrono::steady_clock::now();
+        auto nearest_deadline = probes.front().deadline;
+        
+        fds.resize(probes.size());
+        for (size_t i = 0; i < probes.size(); i++) {
+            fds[i] = { probes[i].socket, POLLOUT, 0 };
+            nearest_deadline = std::min(nearest_deadline, probes[i].deadline);
+        }
+        
+        int timeout_ms = std::max(0, (int)std::chrono::duration_cast<std::chrono::milliseconds>(nearest_deadline - now).count());
+        if (poll(fds.data(), fds.size(), timeout_ms) < 0 && errno != EINTR) {
+            Logger::error("HostScanner", "poll failed: %d", errno);
+            break;
+        }
+        
+        now = std::chrono::steady_clock::now();
+        size_t kept = 0;
+        
+        for (size_t i = 0; i < probes.size(); i++) {
+            Probe probe = probes[i];
+            
+            if (fds[i].revents != 0) {
+                bool is_connected = (fds[i].revents & POLLOUT) && probe_is_connected(probe.socket);
+                close(probe.socket);
+                
+                if (is_connected) {
+                    found++;
+                    on_found(addresses[probe.address_index]);
+                }
+            } else if (now >= probe.deadline) {
+                close(probe.socket);
+            } else {
+                probes[kept++] = probe;
+            }
+        }
+        probes.resize(kept);
+    }
+    
+    for (auto &probe: probes) {
+        close(probe.socket);
+    }
+    
+    auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    Logger::info("HostScanner", "Scanned %zu addresses in %lld ms, found %zu", addresses.size(), (long long)duration_ms, found);
+}
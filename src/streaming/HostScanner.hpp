@@ -0,0 +1,9 @@
+#include <string>
+#include <vector>
+#include <functional>
+#pragma once
+
+// Probes a TCP port on all addresses with a window of non-blocking connects.
+// on_found is called from the poll loop with every address which accepted the connection,
+// as soon as it answered, so the caller can start with it while the sweep goes on.
+void scan_open_hosts(const std::vector<std::string> &addresses, unsigned short port, const std::function<void(const std::string&)> &on_found);
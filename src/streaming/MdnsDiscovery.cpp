@@ -0,0 +1,243 @@
+#include "MdnsDiscovery.hpp"
+#include "Logger.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#define MDNS_SERVICE "_nvstream._tcp.local"
+
+// Multicast over WiFi is lossy, the query is repeated with a gap, so a burst
+// of interference doesn't drop every copy
+#define MDNS_QUERY_COUNT 3
+#define MDNS_QUERY_INTERVAL_MS 250
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_PTR 12
+#define DNS_CLASS_IN 1
+#define DNS_CLASS_UNICAST_RESPONSE 0x8000
+
+static size_t append_name(unsigned char *buffer, size_t offset, const std::string &name) {
+    size_t start = 0;
+    
+    while (start < name.size()) {
+        size_t end = name.find('.', start);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+        
+        buffer[offset++] = end - start;
+        memcpy(buffer + offset, name.data() + start, end - start);
+        offset += end - start;
+        start = end + 1;
+    }
+    buffer[offset++] = 0;
+    return offset;
+}
+
+static size_t create_query(unsigned char *buffer) {
+    // Header: id 0, standard query, one question
+    memset(buffer, 0, 12);
+    buffer[5] = 1;
+    
+    size_t offset = append_name(buffer, 12, MDNS_SERVICE);
+    buffer[offset++] = 0;
+    buffer[offset++] = DNS_TYPE_PTR;
+    buffer[offset++] = (DNS_CLASS_IN | DNS_CLASS_UNICAST_RESPONSE) >> 8;
+    buffer[offset++] = DNS_CLASS_IN & 0xFF;
+    return offset;
+}
+
+static uint16_t read_u16(const unsigned char *data) {
+    return (data[0] << 8) | data[1];
+}
+
+// Reads a possibly compressed name, returns offset after the name in the record or 0 on error
+static size_t read_name(const unsigned char *data, size_t length, size_t offset, std::string *name) {
+    size_t end = 0;
+    int jumps = 0;
+    
+    name->clear();
+    
+    while (offset < length) {
+        unsigned char label_length = data[offset];
+        
+        if (label_length == 0) {
+            return end ? end : offset + 1;
+        }
+        
+        if ((label_length & 0xC0) == 0xC0) {
+            if (offset + 1 >= length || ++jumps > 16) {
+                return 0;
+            }
+            
+            if (!end) {
+                end = offset + 2;
+            }
+            offset = ((label_length & 0x3F) << 8) | data[offset + 1];
+            continue;
+        }
+        
+        if (offset + 1 + label_length > length) {
+            return 0;
+        }
+        
+        if (!name->empty()) {
+            name->push_back('.');
+        }
+        name->append((const char *)data + offset + 1, label_length);
+        offset += 1 + label_length;
+    }
+    return 0;
+}
+
+// Appends A records of a response which answers the nvstream query
+static void parse_response(const unsigned char *data, size_t length, const std::string &sender, std::vector<std::string> *addresses) {
+    if (length < 12) {
+        return;
+    }
+    
+    int questions = read_u16(data + 4);
+    int records = read_u16(data + 6) + read_u16(data + 8) + read_u16(data + 10);
+    size_t offset = 12;
+    std::string name;
+    
+    for (int i = 0; i < questions; i++) {
+        offset = read_name(data, length, offset, &name);
+        if (offset == 0 || offset + 4 > length) {
+            return;
+        }
+        offset += 4;
+    }
+    
+    bool is_nvstream = false;
+    std::vector<std::string> found;
+    
+    for (int i = 0; i < records; i++) {
+        offset = read_name(data, length, offset, &name);
+        if (offset == 0 || offset + 10 > length) {
+            return;
+        }
+        
+        uint16_t type = read_u16(data + offset);
+        uint16_t data_length = read_u16(data + offset + 8);
+        offset += 10;
+        
+        if (offset + data_length > length) {
+            return;
+        }
+        
+        if (type == DNS_TYPE_PTR && strcasecmp(name.c_str(), MDNS_SERVICE) == 0) {
+            is_nvstream = true;
+        } else if (type == DNS_TYPE_A && data_length == 4) {
+            char address[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, data + offset, address, sizeof(address));
+            found.push_back(address);
+        }
+        offset += data_length;
+    }
+    
+    if (!is_nvstream) {
+        return;
+    }
+    
+    // GFE sends the A record as additional, fallback to the packet source otherwise
+    if (found.empty()) {
+        found.push_back(sender);
+    }
+    
+    for (auto &address: found) {
+        if (std::find(addresses->begin(), addresses->end(), address) == addresses->end()) {
+            addresses->push_back(address);
+        }
+    }
+}
+
+void discover_mdns_hosts(int timeout_ms, const std::function<void(const std::string&)> &on_found, const std::string &query_address, unsigned short query_port) {
+    int mdns_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (mdns_socket < 0) {
+        Logger::error("MdnsDiscovery", "Failed to create socket: %d", errno);
+        return;
+    }
+    
+    // The query is sent from an ephemeral port, so responders answer it by unicast
+    // and the multicast group doesn't have to be joined
+    unsigned char ttl = 255;
+    setsockopt(mdns_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(query_port);
+    inet_pton(AF_INET, query_address.c_str(), &addr.sin_addr);
+    
+    unsigned char query[512];
+    size_t query_length = create_query(query);
+    unsigned char buffer[1500];
+    
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds(timeout_ms);
+    auto next_query = start;
+    int queries = 0;
+    
+    // Every host is reported once, the repeated queries are answered again
+    std::vector<std::string> addresses;
+    
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            break;
+        }
+        
+        if (queries < MDNS_QUERY_COUNT && now >= next_query) {
+            if (sendto(mdns_socket, query, query_length, 0, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                Logger::error("MdnsDiscovery", "Failed to send query: %d", errno);
+            }
+            
+            queries++;
+            next_query += std::chrono::milliseconds(MDNS_QUERY_INTERVAL_MS);
+        }
+        
+        auto wake_up = queries < MDNS_QUERY_COUNT ? std::min(next_query, deadline) : deadline;
+        int timeout = std::max(0, (int)std::chrono::duration_cast<std::chrono::milliseconds>(wake_up - now).count());
+        
+        struct pollfd fd = { mdns_socket, POLLIN, 0 };
+        int ready = poll(&fd, 1, timeout);
+        
+        if (ready < 0 && errno != EINTR) {
+            Logger::error("MdnsDiscovery", "poll failed: %d", errno);
+            break;
+        }
+        
+        if (ready <= 0) {
+            continue;
+        }
+        
+        struct sockaddr_in sender;
+        socklen_t sender_length = sizeof(sender);
+        long length = recvfrom(mdns_socket, buffer, sizeof(buffer), 0, (struct sockaddr *)&sender, &sender_length);
+        
+        if (length > 0) {
+            char sender_address[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &sender.sin_addr, sender_address, sizeof(sender_address));
+            
+            size_t count = addresses.size();
+            parse_response(buffer, length, sender_address, &addresses);
+            
+            for (size_t i = count; i < addresses.size(); i++) {
+                auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+                Logger::info("MdnsDiscovery", "Found %s in %lld ms", addresses[i].c_str(), (long long)elapsed_ms);
+                on_found(addresses[i]);
+            }
+        }
+    }
+    
+    close(mdns_socket);
+}
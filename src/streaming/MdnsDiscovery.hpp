@@ -0,0 +1,12 @@
+#include <string>
+#include <functional>
+#pragma once
+
+#define MDNS_ADDRESS "224.0.0.251"
+#define MDNS_PORT 5353
+
+// Sends a _nvstream._tcp DNS-SD query to the mDNS group, or to another responder
+// (a local one in tests), and repeats it a few times until timeout_ms.
+// on_found is called with the IPv4 address of every host as soon as its answer arrives.
+void discover_mdns_hosts(int timeout_ms, const std::function<void(const std::string&)> &on_found,
+                         const std::string &query_address = MDNS_ADDRESS, unsigned short query_port = MDNS_PORT);
@@ -6,6 +6,9 @@
 #include "AVFrameHolder.hpp"
 #include <nanogui/nanogui.h>
 
+// Lip sync is noticeable over ~45 ms of late audio
+#define AV_SYNC_BOUND_MS 20
+
 static MoonlightSession* m_active_session = nullptr;
 
 MoonlightSession::MoonlightSession(const std::string &address, int app_id) {
@@ -158,15 +161,58 @@ void MoonlightSession::audio_renderer_decode_and_play_sample(char* sample_data,
 
 // MARK: MoonlightSession
 
+static int stream_width(const SERVER_DATA &server_data, int height, int fps) {
+    int width = height * 16 / 9;
+    int host_width = 0;
+    
+    // Prefer 16:9, but use the host's own mode with the same height
+    // (e.g. 21:9 or 16:10 displays) if the host doesn't report a 16:9 one
+    for (PDISPLAY_MODE mode = server_data.modes; mode != NULL; mode = mode->next) {
+        if (mode->height != height) {
+            continue;
+        }
+        
+        if (mode->width == width) {
+            return width;
+        }
+        
+        if (host_width == 0 || mode->refresh == fps) {
+            host_width = mode->width;
+        }
+    }
+    return host_width != 0 ? host_width : width;
+}
+
 void MoonlightSession::start(ServerCallback<bool> callback) {
     LiInitializeStreamConfiguration(&m_config);
     
     int h = Settings::instance().resolution();
-    int w = h * 16 / 9;
+    auto server_data = GameStreamClient::instance().server_data(m_address);
+    int w = server_data ? stream_width(*server_data, h, Settings::instance().fps()) : h * 16 / 9;
+    
+    Logger::info("MoonlightSession", "Stream mode: %ix%i", w, h);
+    
     m_config.width = w;
     m_config.height = h;
     m_config.fps = Settings::instance().fps();
-    m_config.audioConfiguration = AUDIO_CONFIGURATION_STEREO;
+    
+    switch (Settings::instance().audio_channels()) {
+        case SURROUND_51:
+            m_config.audioConfiguration = AUDIO_CONFIGURATION_51_SURROUND;
+            break;
+        case SURROUND_71:
+            #ifdef AUDIO_CONFIGURATION_71_SURROUND
+            m_config.audioConfiguration = AUDIO_CONFIGURATION_71_SURROUND;
+            #else
+            Logger::info("MoonlightSession", "7.1 surround is not supported by moonlight-common-c, use 5.1");
+            m_config.audioConfiguration = AUDIO_CONFIGURATION_51_SURROUND;
+            #endif
+            break;
+        default:
+            m_config.audioConfiguration = AUDIO_CONFIGURATION_STEREO;
+            break;
+    }
+    
     m_config.packetSize = 1392;
     m_config.streamingRemotely = STREAM_CFG_LOCAL;
     m_config.bitrate = Settings::instance().bitrate();
@@ -179,6 +225,12 @@ void MoonlightSession::start(ServerCallback<bool> callback) {
             m_config.supportsHevc = 1;
             m_config.hevcBitratePercentageMultiplier = 75;
             break;
+        case H265_MAIN10:
+            // Main10 is only negotiated by the host in the HDR mode
+            m_config.supportsHevc = 1;
+            m_config.enableHdr = 1;
+            m_config.hevcBitratePercentageMultiplier = 75;
+            break;
         default:
             break;
     }
@@ -219,8 +271,16 @@ void MoonlightSession::start(ServerCallback<bool> callback) {
         if (result.isSuccess()) {
             m_config = result.value();
             
-            auto m_data = GameStreamClient::instance().server_data(m_address);
-            int result = LiStartConnection(&m_data.serverInfo, &m_config, &m_connection_callbacks, &m_video_callbacks, &m_audio_callbacks, NULL, 0, NULL, 0);
+            // serverInfo points into the strings of the snapshot, so it's held until the connection has started
+            auto server_data = GameStreamClient::instance().server_data(m_address);
+            
+            if (!server_data) {
+                callback(GSResult<bool>::failure("Firstly call connect() & pair()..."));
+                return;
+            }
+            
+            SERVER_INFORMATION server_info = server_data->serverInfo;
+            int result = LiStartConnection(&server_info, &m_config, &m_connection_callbacks, &m_video_callbacks, &m_audio_callbacks, NULL, 0, NULL, 0);
             
             if (result != 0) {
                 LiStopConnection();
@@ -243,13 +303,36 @@ void MoonlightSession::stop(int terminate_app) {
     LiStopConnection();
 }
 
-void MoonlightSession::draw() {
+void MoonlightSession::draw(int width, int height) {
     if (m_video_decoder && m_video_renderer) {
-        AVFrameHolder::instance().get([this](auto frame) {
-            m_video_renderer->draw(m_config.width, m_config.height, frame);
+        AVFrameHolder::instance().get([this, width, height](auto frame) {
+            m_video_renderer->draw(width, height, frame);
         });
         
         m_session_stats.video_decode_stats = *m_video_decoder->video_decode_stats();
         m_session_stats.video_render_stats = *m_video_renderer->video_render_stats();
     }
+    
+    if (m_audio_renderer) {
+        m_session_stats.audio_render_stats = *m_audio_renderer->audio_render_stats();
+    }
+    
+    update_av_sync();
+}
+
+void MoonlightSession::update_av_sync() {
+    if (!m_audio_renderer || m_session_stats.video_render_stats.frame_latency_ms <= 0) {
+        return;
+    }
+    
+    // Audio has no host timestamps in the protocol, but audio and video are sent together.
+    // So the offset is the difference of the local latencies from receive to presentation.
+    float video_latency = m_session_stats.video_render_stats.frame_latency_ms;
+    float audio_latency = m_session_stats.audio_render_stats.latency_ms;
+    m_session_stats.av_offset_ms = audio_latency - video_latency;
+    
+    // Video is not delayed, it's the interactive path. Audio is trimmed or delayed instead.
+    if (Settings::instance().av_sync()) {
+        m_audio_renderer->set_latency_bounds(video_latency - AV_SYNC_BOUND_MS, video_latency + AV_SYNC_BOUND_MS);
+    }
 }
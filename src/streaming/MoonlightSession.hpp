@@ -7,6 +7,8 @@
 struct SessionStats {
     VideoDecodeStats video_decode_stats;
     VideoRenderStats video_render_stats;
+    AudioRenderStats audio_render_stats;
+    float av_offset_ms; // > 0 if audio is played later than video
 };
 
 class MoonlightSession {
@@ -29,7 +31,7 @@ public:
     void start(ServerCallback<bool> callback);
     void stop(int terminate_app);
     
-    void draw();
+    void draw(int width, int height);
     
     bool is_active() const {
         return m_is_active;
@@ -44,6 +46,8 @@ public:
     }
     
 private:
+    void update_av_sync();
+    
     static void connection_stage_starting(int);
     static void connection_stage_complete(int);
     static void connection_stage_failed(int, int);
@@ -0,0 +1,99 @@
+#include "AudioDownmix.hpp"
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define DOWNMIX_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DOWNMIX_USE_SSE2
+#endif
+
+#define COEFFICIENT_SHIFT 14
+
+// -6 dB for front, -9 dB for center and surround, so a full scale mix rarely clips.
+// LFE is dropped, like most stereo downmixes do.
+#define FRONT_GAIN 8192
+#define CENTER_GAIN 5793
+#define SURROUND_GAIN 5793
+
+static inline int16_t saturate(int32_t value) {
+    return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : (int16_t)value);
+}
+
+void AudioDownmix::init(int channels) {
+    m_channels = channels > AUDIO_DOWNMIX_MAX_CHANNELS ? AUDIO_DOWNMIX_MAX_CHANNELS : channels;
+    memset(m_left, 0, sizeof(m_left));
+    memset(m_right, 0, sizeof(m_right));
+    
+    m_left[0] = FRONT_GAIN;
+    m_right[1] = FRONT_GAIN;
+    
+    if (m_channels >= 6) {
+        m_left[2] = m_right[2] = CENTER_GAIN;
+        m_left[4] = SURROUND_GAIN;
+        m_right[5] = SURROUND_GAIN;
+    }
+    
+    if (m_channels >= 8) {
+        m_left[6] = SURROUND_GAIN;
+        m_right[7] = SURROUND_GAIN;
+    }
+}
+
+void AudioDownmix::process(const int16_t* input, int frames, int16_t* output) const {
+    int i = 0;
+    
+    // Each frame is loaded as 8 lanes, the last frames are left to the scalar loop to not read past input
+    int vector_frames = frames - (AUDIO_DOWNMIX_MAX_CHANNELS + m_channels - 1) / m_channels + 1;
+
+#if defined(DOWNMIX_USE_NEON)
+    int16x8_t left = vld1q_s16(m_left);
+    int16x8_t right = vld1q_s16(m_right);
+    
+    for (; i < vector_frames; i++) {
+        int16x8_t frame = vld1q_s16(input + i * m_channels);
+        int32x4_t l = vmlal_s16(vmull_s16(vget_low_s16(frame), vget_low_s16(left)), vget_high_s16(frame), vget_high_s16(left));
+        int32x4_t r = vmlal_s16(vmull_s16(vget_low_s16(frame), vget_low_s16(right)), vget_high_s16(frame), vget_high_s16(right));
+        int32x2_t lr = vpadd_s32(vpadd_s32(vget_low_s32(l), vget_high_s32(l)), vpadd_s32(vget_low_s32(r), vget_high_s32(r)));
+        int16x4_t result = vqshrn_n_s32(vcombine_s32(lr, lr), COEFFICIENT_SHIFT);
+        vst1_lane_s32((int32_t *)(output + i * 2), vreinterpret_s32_s16(result), 0);
+    }
+#elif defined(DOWNMIX_USE_SSE2)
+    __m128i left = _mm_load_si128((const __m128i *)m_left);
+    __m128i right = _mm_load_si128((const __m128i *)m_right);
+    
+    for (; i < vector_frames; i++) {
+        __m128i frame = _mm_loadu_si128((const __m128i *)(input + i * m_channels));
+        __m128i l = _mm_madd_epi16(frame, left);
+        __m128i r = _mm_madd_epi16(frame, right);
+        
+        // Horizontal sums of l and r in the lanes 0 and 1
+        __m128i sum = _mm_add_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r));
+        sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+        sum = _mm_srai_epi32(sum, COEFFICIENT_SHIFT);
+        
+        int32_t result = _mm_cvtsi128_si32(_mm_packs_epi32(sum, sum));
+        memcpy(output + i * 2, &result, sizeof(result));
+    }
+#endif
+    
+    if (i < frames) {
+        process_scalar(input + i * m_channels, frames - i, output + i * 2);
+    }
+}
+
+void AudioDownmix::process_scalar(const int16_t* input, int frames, int16_t* output) const {
+    for (int i = 0; i < frames; i++) {
+        const int16_t* frame = input + i * m_channels;
+        int32_t l = 0, r = 0;
+        
+        for (int c = 0; c < m_channels; c++) {
+            l += frame[c] * m_left[c];
+            r += frame[c] * m_right[c];
+        }
+        
+        output[i * 2] = saturate(l >> COEFFICIENT_SHIFT);
+        output[i * 2 + 1] = saturate(r >> COEFFICIENT_SHIFT);
+    }
+}
@@ -0,0 +1,30 @@
+#include <stdint.h>
+#pragma once
+
+#define AUDIO_DOWNMIX_MAX_CHANNELS 8
+
+// Downmix of interleaved s16 5.1 / 7.1 frames to stereo, in moonlight channel order:
+// FL, FR, FC, LFE, BL, BR, (SL, SR)
+class AudioDownmix {
+public:
+    AudioDownmix() {};
+    
+    void init(int channels);
+    
+    int channels() const {
+        return m_channels;
+    }
+    
+    // Writes frames stereo frames to output
+    void process(const int16_t* input, int frames, int16_t* output) const;
+    
+    // The same without SIMD, it's the reference of process() in tests and benchmarks
+    void process_scalar(const int16_t* input, int frames, int16_t* output) const;
+    
+private:
+    int m_channels = 2;
+    
+    // Q14 coefficient rows, padded to 8 lanes with zeros
+    alignas(16) int16_t m_left[AUDIO_DOWNMIX_MAX_CHANNELS] = {};
+    alignas(16) int16_t m_right[AUDIO_DOWNMIX_MAX_CHANNELS] = {};
+};
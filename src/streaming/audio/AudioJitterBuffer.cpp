@@ -0,0 +1,80 @@
+#include "AudioJitterBuffer.hpp"
+#include <math.h>
+#include <algorithm>
+
+#define MIN_TARGET_MS 20.0f
+#define MAX_TARGET_MS 120.0f
+#define JITTER_MULTIPLIER 3.0f
+#define UNDERRUN_BOOST_MS 10.0f
+#define MAX_UNDERRUN_BOOST_MS 60.0f
+#define UNDERRUN_BOOST_DECAY_MS_PER_SEC 1.0f
+
+#define ERROR_SMOOTHING 16
+// 10 ms of error moves the drift estimate by ~100 ppm in 10 seconds
+#define DRIFT_GAIN 1e-10
+#define MAX_DRIFT 0.001
+// 10 ms of error is corrected in ~2 seconds, 2% of speed at most
+#define CORRECTION_GAIN 1e-5
+#define MAX_CORRECTION 0.02
+// Above it the excess is dropped, below the correction drains it in ~2 seconds
+#define MAX_EXCESS_MS 20.0f
+
+void AudioJitterBuffer::reset(int sample_rate, int packet_frames) {
+    m_sample_rate = sample_rate;
+    m_packet_frames = packet_frames;
+    m_last_arrival_us = 0;
+    m_last_underrun_us = 0;
+    m_jitter_ms = 0;
+    m_underrun_boost_ms = 0;
+    m_target_ms = MIN_TARGET_MS;
+    m_smoothed_error = 0;
+    m_drift = 0;
+    m_min_bound_ms = 0;
+    m_max_bound_ms = 0;
+}
+
+void AudioJitterBuffer::packet_arrived(uint64_t now_us) {
+    if (m_last_arrival_us != 0) {
+        // RFC 3550 style interarrival jitter, against the packet duration
+        float expected_ms = 1000.0f * m_packet_frames / m_sample_rate;
+        float deviation_ms = fabsf((now_us - m_last_arrival_us) / 1000.0f - expected_ms);
+        float jitter_ms = m_jitter_ms;
+        m_jitter_ms = jitter_ms + (deviation_ms - jitter_ms) / 16;
+    }
+    
+    m_last_arrival_us = now_us;
+    update_target(now_us);
+}
+
+void AudioJitterBuffer::underrun_happened() {
+    m_underrun_boost_ms = std::min(m_underrun_boost_ms + UNDERRUN_BOOST_MS, MAX_UNDERRUN_BOOST_MS);
+    m_last_underrun_us = m_last_arrival_us;
+}
+
+void AudioJitterBuffer::update_target(uint64_t now_us) {
+    if (m_underrun_boost_ms > 0 && now_us > m_last_underrun_us) {
+        float seconds = (now_us - m_last_underrun_us) / 1000000.0f;
+        m_underrun_boost_ms = std::max(0.0f, m_underrun_boost_ms - seconds * UNDERRUN_BOOST_DECAY_MS_PER_SEC);
+        m_last_underrun_us = now_us;
+    }
+    
+    float min_target_ms = std::min(std::max(MIN_TARGET_MS, m_min_bound_ms), MAX_TARGET_MS);
+    float max_target_ms = m_max_bound_ms > 0 ? std::min(std::max(m_max_bound_ms, MIN_TARGET_MS), MAX_TARGET_MS) : MAX_TARGET_MS;
+    
+    m_target_ms = std::min(std::max(MIN_TARGET_MS + JITTER_MULTIPLIER * m_jitter_ms + m_underrun_boost_ms, min_target_ms), max_target_ms);
+}
+
+double AudioJitterBuffer::resample_ratio(int queued_frames) {
+    // Smooth out the packet jitter, it's not a drift
+    m_smoothed_error += ((queued_frames - target_frames()) - m_smoothed_error) / ERROR_SMOOTHING;
+    
+    double drift = std::min(std::max(m_drift + m_smoothed_error * DRIFT_GAIN, -MAX_DRIFT), MAX_DRIFT);
+    m_drift = drift;
+    
+    double correction = std::min(std::max(m_smoothed_error * CORRECTION_GAIN, -MAX_CORRECTION), MAX_CORRECTION);
+    return 1.0 + drift + correction;
+}
+
+bool AudioJitterBuffer::should_drop_packet(int queued_frames) const {
+    return queued_frames > target_frames() + (int)(MAX_EXCESS_MS * m_sample_rate / 1000);
+}
@@ -0,0 +1,67 @@
+#include <stdint.h>
+#include <atomic>
+#pragma once
+
+// Estimates packet arrival jitter and underruns, and gives a target queue
+// latency for an audio renderer. A renderer reaches the target smoothly,
+// by resampling every decoded packet with a ratio from resample_ratio().
+// The getters may be called from another thread than the updates.
+class AudioJitterBuffer {
+public:
+    AudioJitterBuffer() {};
+    
+    void reset(int sample_rate, int packet_frames);
+    
+    // Call on every received packet, with a monotonic time in microseconds
+    void packet_arrived(uint64_t now_us);
+    void underrun_happened();
+    
+    // Bounds of the target on top of its own limits, from the A/V sync
+    void set_latency_bounds(float min_ms, float max_ms) {
+        m_min_bound_ms = min_ms;
+        m_max_bound_ms = max_ms;
+    }
+    
+    // PI controller on the queue fill level, call once per packet. The integral
+    // part follows the clock drift between host and local audio clocks.
+    // Returns a count of input frames to consume per output frame.
+    double resample_ratio(int queued_frames);
+    
+    // A burst after a stall fills the queue far above the target, resampling
+    // would take seconds to drain it. Such a packet is dropped after decoding,
+    // instead of resample_ratio() and queueing.
+    bool should_drop_packet(int queued_frames) const;
+    
+    int target_frames() const {
+        return (int)(m_target_ms * m_sample_rate / 1000);
+    }
+    
+    float target_ms() const {
+        return m_target_ms;
+    }
+    
+    float jitter_ms() const {
+        return m_jitter_ms;
+    }
+    
+    float drift_ppm() const {
+        return (float)(m_drift * 1000000);
+    }
+    
+private:
+    void update_target(uint64_t now_us);
+    
+    int m_sample_rate = 48000;
+    int m_packet_frames = 240;
+    uint64_t m_last_arrival_us = 0;
+    uint64_t m_last_underrun_us = 0;
+    float m_underrun_boost_ms = 0;
+    float m_min_bound_ms = 0;
+    float m_max_bound_ms = 0;
+    float m_smoothed_error = 0;
+    
+    // Written by the audio thread only, read by UI for the stats
+    std::atomic<float> m_jitter_ms = {0};
+    std::atomic<float> m_target_ms = {0};
+    std::atomic<double> m_drift = {0};
+};
@@ -0,0 +1,258 @@
+#include "AudioPipeline.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
+
+// Longer gaps are left to the jitter buffer
+#define MAX_CONCEALED_PACKETS 8
+
+static uint64_t get_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AudioPipeline::~AudioPipeline() {
+    cleanup();
+}
+
+bool AudioPipeline::init(const POPUS_MULTISTREAM_CONFIGURATION opus_config, int max_channel_count, int packet_frames) {
+    cleanup();
+    
+    m_stream_channel_count = opus_config->channelCount;
+    m_channel_count = std::min(m_stream_channel_count, max_channel_count);
+    m_sample_rate = opus_config->sampleRate;
+    m_packet_frames = packet_frames;
+    m_has_packet_loss = false;
+    m_last_packet_us = 0;
+    m_underruns = 0;
+    m_handled_underruns = 0;
+    m_overruns = 0;
+    m_dropped_packets = 0;
+    m_max_queued_frames = 0;
+    m_received_packets = 0;
+    m_decoded_packets = 0;
+    m_total_decode_time_us = 0;
+    m_max_decode_time_us = 0;
+    m_lost_packets = 0;
+    m_concealed_frames = 0;
+    m_fec_frames = 0;
+    m_downmixed_packets = 0;
+    m_total_downmix_time_ns = 0;
+    m_jitter_buffer.reset(m_sample_rate, m_packet_frames);
+    m_resampler.reset(m_channel_count);
+    
+    if (m_stream_channel_count > AUDIO_DOWNMIX_MAX_CHANNELS) {
+        Logger::error("AudioPipeline", "Unsupported channel count: %i", m_stream_channel_count);
+        return false;
+    }
+    
+    m_downmix.init(m_stream_channel_count);
+    
+    m_decoded_buffer = (int16_t *)malloc(m_stream_channel_count * m_packet_frames * sizeof(int16_t));
+    m_downmixed_buffer = (int16_t *)malloc(m_channel_count * m_packet_frames * sizeof(int16_t));
+    m_resampled_buffer = (int16_t *)malloc(m_channel_count * max_resampled_frames(m_packet_frames) * sizeof(int16_t));
+    
+    if (!m_decoded_buffer || !m_downmixed_buffer || !m_resampled_buffer) {
+        Logger::error("AudioPipeline", "Buffer alloc failed");
+        return false;
+    }
+    
+    int error;
+    m_decoder = opus_multistream_decoder_create(opus_config->sampleRate, opus_config->channelCount, opus_config->streams, opus_config->coupledStreams, opus_config->mapping, &error);
+    
+    if (!m_decoder) {
+        Logger::error("AudioPipeline", "opus_multistream_decoder_create: %i", error);
+        return false;
+    }
+    return true;
+}
+
+void AudioPipeline::cleanup() {
+    if (m_decoder) {
+        if (m_decoded_packets > 0) {
+            Logger::info("AudioPipeline", "Decoded %u packets, avg %.1f us, max %llu us, max queue %u frames, underruns %u, overruns %u, dropped %u, lost %u",
+                         m_decoded_packets.load(), (float)m_total_decode_time_us / m_decoded_packets, (unsigned long long)m_max_decode_time_us.load(),
+                         m_max_queued_frames.load(), m_underruns.load(), m_overruns.load(), m_dropped_packets.load(), m_lost_packets.load());
+        }
+        
+        opus_multistream_decoder_destroy(m_decoder);
+        m_decoder = nullptr;
+    }
+    
+    if (m_decoded_buffer) {
+        free(m_decoded_buffer);
+        m_decoded_buffer = nullptr;
+    }
+    
+    if (m_downmixed_buffer) {
+        free(m_downmixed_buffer);
+        m_downmixed_buffer = nullptr;
+    }
+    
+    if (m_resampled_buffer) {
+        free(m_resampled_buffer);
+        m_resampled_buffer = nullptr;
+    }
+}
+
+void AudioPipeline::decode_and_play_sample(const unsigned char *data, int length) {
+    if (!m_decoder) {
+        return;
+    }
+    
+    // moonlight-common-c calls it with NULL once for every sequence gap
+    if (data == NULL || length <= 0) {
+        m_has_packet_loss = true;
+        return;
+    }
+    
+    uint64_t now_us = get_time_ns() / 1000;
+    
+    if (m_has_packet_loss) {
+        m_has_packet_loss = false;
+        conceal_lost_packets(now_us, data, length);
+    }
+    
+    m_last_packet_us = now_us;
+    m_received_packets++;
+    m_jitter_buffer.set_latency_bounds(m_min_latency_ms, m_max_latency_ms);
+    m_jitter_buffer.packet_arrived(now_us);
+    
+    uint32_t underruns = m_underruns;
+    if (underruns != m_handled_underruns) {
+        m_handled_underruns = underruns;
+        m_jitter_buffer.underrun_happened();
+    }
+    
+    uint64_t before_decode = get_time_ns();
+    int decoded_samples = opus_multistream_decode(m_decoder, data, length, m_decoded_buffer, m_packet_frames, 0);
+    uint64_t decode_time_us = (get_time_ns() - before_decode) / 1000;
+    
+    m_decoded_packets++;
+    m_total_decode_time_us += decode_time_us;
+    if (decode_time_us > m_max_decode_time_us) {
+        m_max_decode_time_us = decode_time_us;
+    }
+    
+    if (decoded_samples > 0) {
+        play_decoded_samples(decoded_samples);
+    }
+}
+
+void AudioPipeline::conceal_lost_packets(uint64_t now_us, const unsigned char *data, int length) {
+    // A gap size is not reported, so estimate it by the arrival time
+    int lost_packets = 1;
+    
+    if (m_last_packet_us != 0) {
+        uint64_t packet_us = 1000000ULL * m_packet_frames / m_sample_rate;
+        lost_packets = (int)((now_us - m_last_packet_us + packet_us / 2) / packet_us) - 1;
+        lost_packets = std::min(std::max(lost_packets, 1), MAX_CONCEALED_PACKETS);
+    }
+    
+    m_lost_packets += lost_packets;
+    
+    for (int i = 0; i < lost_packets - 1; i++) {
+        int decoded_samples = opus_multistream_decode(m_decoder, NULL, 0, m_decoded_buffer, m_packet_frames, 0);
+        
+        if (decoded_samples > 0) {
+            m_concealed_frames++;
+            play_decoded_samples(decoded_samples);
+        }
+    }
+    
+    // The last lost packet is recovered from in-band FEC of the next one,
+    // opus falls back to concealment if the packet has no FEC data
+    int decoded_samples = opus_multistream_decode(m_decoder, data, length, m_decoded_buffer, m_packet_frames, 1);
+    
+    if (decoded_samples > 0) {
+        m_fec_frames++;
+        play_decoded_samples(decoded_samples);
+    }
+}
+
+void AudioPipeline::play_decoded_samples(int decoded_samples) {
+    const int16_t* samples = m_decoded_buffer;
+    
+    if (m_stream_channel_count > m_channel_count) {
+        uint64_t start = get_time_ns();
+        m_downmix.process(m_decoded_buffer, decoded_samples, m_downmixed_buffer);
+        m_total_downmix_time_ns += get_time_ns() - start;
+        m_downmixed_packets++;
+        samples = m_downmixed_buffer;
+    }
+    
+    int queued = queued_frames();
+    
+    if (m_jitter_buffer.should_drop_packet(queued)) {
+        m_dropped_packets++;
+        return;
+    }
+    
+    m_resampler.set_ratio(m_jitter_buffer.resample_ratio(queued));
+    
+    int max_frames = max_resampled_frames(decoded_samples);
+    size_t span_count = 0;
+    int16_t* span = m_ring_buffer.write_span(&span_count);
+    
+    // Resample straight into the ring, like an audren mempool, copy only at the end of it
+    if (span_count >= (size_t)(max_frames * m_channel_count)) {
+        int frames = m_resampler.process(samples, decoded_samples, span, max_frames);
+        m_ring_buffer.commit_write(frames * m_channel_count);
+        return;
+    }
+    
+    int frames = m_resampler.process(samples, decoded_samples, m_resampled_buffer, max_frames);
+    size_t count = frames * m_channel_count;
+    
+    // Never wait for the sink here, it's the audio receive thread
+    if (m_ring_buffer.write(m_resampled_buffer, count) < count) {
+        m_overruns++;
+    }
+}
+
+int AudioPipeline::queued_frames() const {
+    if (m_channel_count == 0) {
+        return 0;
+    }
+    return m_ring_buffer.size() / m_channel_count;
+}
+
+void AudioPipeline::set_latency_bounds(float min_ms, float max_ms) {
+    m_min_latency_ms = min_ms;
+    m_max_latency_ms = max_ms;
+}
+
+int AudioPipeline::device_queued_frames() {
+    uint32_t queued = queued_frames();
+    
+    // Only the sink thread writes it, the UI thread reads
+    if (queued > m_max_queued_frames) {
+        m_max_queued_frames = queued;
+    }
+    return queued;
+}
+
+void AudioPipeline::underrun_happened() {
+    m_underruns++;
+}
+
+void AudioPipeline::fill_stats(AudioRenderStats *stats) const {
+    stats->queued_samples = queued_frames();
+    stats->underruns = m_underruns;
+    stats->overruns = m_overruns;
+    stats->dropped_packets = m_dropped_packets;
+    stats->latency_ms = m_sample_rate > 0 ? 1000.0f * stats->queued_samples / m_sample_rate : 0;
+    stats->target_latency_ms = m_jitter_buffer.target_ms();
+    stats->jitter_ms = m_jitter_buffer.jitter_ms();
+    stats->drift_ppm = m_jitter_buffer.drift_ppm();
+    stats->lost_packets = m_lost_packets;
+    stats->concealed_frames = m_concealed_frames;
+    stats->fec_frames = m_fec_frames;
+    stats->downmixed_packets = m_downmixed_packets;
+    stats->total_downmix_time_ns = m_total_downmix_time_ns;
+    stats->received_packets = m_received_packets;
+    stats->decoded_packets = m_decoded_packets;
+    stats->total_decode_time_us = m_total_decode_time_us;
+    stats->max_decode_time_us = m_max_decode_time_us;
+    stats->max_queued_samples = m_max_queued_frames;
+}
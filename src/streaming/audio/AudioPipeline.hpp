@@ -0,0 +1,97 @@
+#include "IAudioRenderer.hpp"
+#include "AudioRingBuffer.hpp"
+#include "AudioJitterBuffer.hpp"
+#include "AudioResampler.hpp"
+#include "AudioDownmix.hpp"
+#include <opus/opus_multistream.h>
+#include <atomic>
+#pragma once
+
+// The decode side of an audio sink, from an Opus packet to the ring: decode with
+// packet loss concealment, downmix to the sink channels, and resample by the jitter
+// buffer. Called on the moonlight-common-c audio thread, the sink consumes the ring
+// at its device clock on an own thread, and reports underruns and the queue from there.
+class AudioPipeline {
+public:
+    AudioPipeline() {};
+    ~AudioPipeline();
+    
+    // The sink initializes the ring after it, with channel_count() channels
+    bool init(const POPUS_MULTISTREAM_CONFIGURATION opus_config, int max_channel_count, int packet_frames);
+    void cleanup();
+    
+    // NULL is a sequence gap, concealed when the next packet arrives
+    void decode_and_play_sample(const unsigned char *data, int length);
+    
+    AudioRingBuffer& ring_buffer() {
+        return m_ring_buffer;
+    }
+    
+    // Of the sink, the stream may have more
+    int channel_count() const {
+        return m_channel_count;
+    }
+    
+    int sample_rate() const {
+        return m_sample_rate;
+    }
+    
+    int queued_frames() const;
+    
+    int target_frames() const {
+        return m_jitter_buffer.target_frames();
+    }
+    
+    void set_latency_bounds(float min_ms, float max_ms);
+    
+    // Sink thread side, the queue as the device sees it, keeps the maximum
+    int device_queued_frames();
+    void underrun_happened();
+    
+    // All but the sink specific stats
+    void fill_stats(AudioRenderStats *stats) const;
+    
+private:
+    // The resampler output for a packet, at most 2% speed up or down
+    int max_resampled_frames(int frames) const {
+        return frames + frames / 16 + 2;
+    }
+    void conceal_lost_packets(uint64_t now_us, const unsigned char *data, int length);
+    void play_decoded_samples(int decoded_samples);
+    
+    OpusMSDecoder* m_decoder = nullptr;
+    int16_t* m_decoded_buffer = nullptr;
+    int16_t* m_downmixed_buffer = nullptr;
+    int16_t* m_resampled_buffer = nullptr;
+    
+    AudioRingBuffer m_ring_buffer;
+    AudioJitterBuffer m_jitter_buffer;
+    std::atomic<float> m_min_latency_ms = {0};
+    std::atomic<float> m_max_latency_ms = {0};
+    AudioResampler m_resampler;
+    AudioDownmix m_downmix;
+    
+    bool m_has_packet_loss = false;
+    uint64_t m_last_packet_us = 0;
+    
+    int m_stream_channel_count = 0;
+    int m_channel_count = 0;
+    int m_sample_rate = 0;
+    int m_packet_frames = 0;
+    
+    // Written by the audio or the sink thread only, read by UI
+    std::atomic<uint32_t> m_underruns = {0};
+    uint32_t m_handled_underruns = 0;
+    std::atomic<uint32_t> m_overruns = {0};
+    std::atomic<uint32_t> m_dropped_packets = {0};
+    std::atomic<uint32_t> m_max_queued_frames = {0};
+    std::atomic<uint32_t> m_received_packets = {0};
+    std::atomic<uint32_t> m_decoded_packets = {0};
+    std::atomic<uint64_t> m_total_decode_time_us = {0};
+    std::atomic<uint64_t> m_max_decode_time_us = {0};
+    std::atomic<uint32_t> m_lost_packets = {0};
+    std::atomic<uint32_t> m_concealed_frames = {0};
+    std::atomic<uint32_t> m_fec_frames = {0};
+    std::atomic<uint32_t> m_downmixed_packets = {0};
+    std::atomic<uint64_t> m_total_downmix_time_ns = {0};
+};
@@ -0,0 +1,94 @@
+#include "AudioResampler.hpp"
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define RESAMPLER_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RESAMPLER_USE_SSE2
+#endif
+
+// Interpolation weights are Q14, so a pair of them fits in s16 lanes
+#define WEIGHT_SHIFT 14
+#define WEIGHT_ONE (1 << WEIGHT_SHIFT)
+
+static inline int16_t lerp_sample(int16_t a, int16_t b, int weight) {
+    return (int16_t)((a * (WEIGHT_ONE - weight) + b * weight) >> WEIGHT_SHIFT);
+}
+
+// Two stereo output frames: a0/b0 and a1/b1 are the neighbour frames, w0/w1 weights of b
+static inline void lerp_stereo_2(const int16_t* a0, const int16_t* b0, int w0, const int16_t* a1, const int16_t* b1, int w1, int16_t* output) {
+#if defined(RESAMPLER_USE_NEON)
+    int16x4_t a = { a0[0], a0[1], a1[0], a1[1] };
+    int16x4_t b = { b0[0], b0[1], b1[0], b1[1] };
+    int16x4_t wa = { (int16_t)(WEIGHT_ONE - w0), (int16_t)(WEIGHT_ONE - w0), (int16_t)(WEIGHT_ONE - w1), (int16_t)(WEIGHT_ONE - w1) };
+    int16x4_t wb = { (int16_t)w0, (int16_t)w0, (int16_t)w1, (int16_t)w1 };
+    int32x4_t sum = vmlal_s16(vmull_s16(a, wa), b, wb);
+    vst1_s16(output, vqshrn_n_s32(sum, WEIGHT_SHIFT));
+#elif defined(RESAMPLER_USE_SSE2)
+    // madd of (a, b) pairs with (1 - w, w) pairs gives a full lerp per 32 bit lane
+    __m128i ab = _mm_setr_epi16(a0[0], b0[0], a0[1], b0[1], a1[0], b1[0], a1[1], b1[1]);
+    __m128i w = _mm_setr_epi16(WEIGHT_ONE - w0, w0, WEIGHT_ONE - w0, w0, WEIGHT_ONE - w1, w1, WEIGHT_ONE - w1, w1);
+    __m128i sum = _mm_srai_epi32(_mm_madd_epi16(ab, w), WEIGHT_SHIFT);
+    _mm_storel_epi64((__m128i *)output, _mm_packs_epi32(sum, sum));
+#else
+    output[0] = lerp_sample(a0[0], b0[0], w0);
+    output[1] = lerp_sample(a0[1], b0[1], w0);
+    output[2] = lerp_sample(a1[0], b1[0], w1);
+    output[3] = lerp_sample(a1[1], b1[1], w1);
+#endif
+}
+
+void AudioResampler::reset(int channels) {
+    m_channels = channels > AUDIO_RESAMPLER_MAX_CHANNELS ? AUDIO_RESAMPLER_MAX_CHANNELS : channels;
+    m_ratio = 1.0;
+    m_position = 0;
+    memset(m_last_frame, 0, sizeof(m_last_frame));
+}
+
+int AudioResampler::resample(const int16_t* input, int input_frames, int16_t* output, int max_output_frames, bool use_simd) {
+    if (input_frames <= 0) {
+        return 0;
+    }
+    
+    // Frame -1 is the last frame of the previous call
+    auto frame_at = [this, input](int index) {
+        return index < 0 ? m_last_frame : input + index * m_channels;
+    };
+    
+    int output_frames = 0;
+    
+    if (m_channels == 2 && use_simd) {
+        while (output_frames + 2 <= max_output_frames && m_position + m_ratio < input_frames - 1) {
+            int i0 = (int)(m_position + 1) - 1;
+            int w0 = (int)((m_position - i0) * WEIGHT_ONE);
+            double position1 = m_position + m_ratio;
+            int i1 = (int)(position1 + 1) - 1;
+            int w1 = (int)((position1 - i1) * WEIGHT_ONE);
+            
+            lerp_stereo_2(frame_at(i0), frame_at(i0 + 1), w0, frame_at(i1), frame_at(i1 + 1), w1, output + output_frames * 2);
+            
+            output_frames += 2;
+            m_position = position1 + m_ratio;
+        }
+    }
+    
+    while (output_frames < max_output_frames && m_position < input_frames - 1) {
+        int i = (int)(m_position + 1) - 1;
+        int w = (int)((m_position - i) * WEIGHT_ONE);
+        const int16_t* a = frame_at(i);
+        const int16_t* b = frame_at(i + 1);
+        
+        for (int c = 0; c < m_channels; c++) {
+            output[output_frames * m_channels + c] = lerp_sample(a[c], b[c], w);
+        }
+        
+        output_frames++;
+        m_position += m_ratio;
+    }
+    
+    m_position -= input_frames;
+    memcpy(m_last_frame, input + (input_frames - 1) * m_channels, m_channels * sizeof(int16_t));
+    return output_frames;
+}
@@ -0,0 +1,36 @@
+#include <stdint.h>
+#pragma once
+
+#define AUDIO_RESAMPLER_MAX_CHANNELS 8
+
+// Linear fractional resampler for interleaved s16 frames. A position is kept
+// between calls, so packets join without clicks when the ratio changes.
+class AudioResampler {
+public:
+    AudioResampler() {};
+    
+    void reset(int channels);
+    
+    // Count of input frames consumed per output frame, ~1.0 to follow clock drift
+    void set_ratio(double ratio) {
+        m_ratio = ratio;
+    }
+    
+    // Returns a count of written output frames
+    int process(const int16_t* input, int input_frames, int16_t* output, int max_output_frames) {
+        return resample(input, input_frames, output, max_output_frames, true);
+    }
+    
+    // The same without the stereo SIMD path, it's the reference of process() in tests
+    int process_scalar(const int16_t* input, int input_frames, int16_t* output, int max_output_frames) {
+        return resample(input, input_frames, output, max_output_frames, false);
+    }
+    
+private:
+    int resample(const int16_t* input, int input_frames, int16_t* output, int max_output_frames, bool use_simd);
+    
+    int m_channels = 2;
+    double m_ratio = 1.0;
+    double m_position = 0;
+    int16_t m_last_frame[AUDIO_RESAMPLER_MAX_CHANNELS] = {};
+};
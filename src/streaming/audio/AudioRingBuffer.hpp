@@ -0,0 +1,136 @@
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#pragma once
+
+// Lock-free single producer / single consumer ring of interleaved s16 samples.
+// The producer is the moonlight-common-c audio thread, the consumer is the renderer thread.
+class AudioRingBuffer {
+public:
+    AudioRingBuffer() {};
+    
+    ~AudioRingBuffer() {
+        release();
+    }
+    
+    // Must not be called while a producer or a consumer is running
+    bool init(size_t capacity) {
+        release();
+        
+        m_buffer = (int16_t *)malloc(capacity * sizeof(int16_t));
+        m_owns_buffer = true;
+        m_capacity = m_buffer ? capacity : 0;
+        m_head.store(0);
+        m_tail.store(0);
+        return m_buffer != nullptr;
+    }
+    
+    // Use an external memory, like an audren mempool, the ring doesn't free it
+    void init(int16_t *buffer, size_t capacity) {
+        release();
+        
+        m_buffer = buffer;
+        m_owns_buffer = false;
+        m_capacity = capacity;
+        m_head.store(0);
+        m_tail.store(0);
+    }
+    
+    size_t capacity() const {
+        return m_capacity;
+    }
+    
+    // Samples available for the consumer
+    size_t size() const {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+    
+    // Samples available for the producer
+    size_t free_space() const {
+        return m_capacity - size();
+    }
+    
+    // Total count of written and consumed samples, for a consumer which uses the memory in place
+    size_t write_position() const {
+        return m_head.load(std::memory_order_acquire);
+    }
+    
+    size_t read_position() const {
+        return m_tail.load(std::memory_order_acquire);
+    }
+    
+    // Producer side, returns count of written samples
+    size_t write(const int16_t *samples, size_t count) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        
+        if (count > m_capacity - (head - tail)) {
+            count = m_capacity - (head - tail);
+        }
+        
+        size_t index = head % m_capacity;
+        size_t first = count < m_capacity - index ? count : m_capacity - index;
+        memcpy(m_buffer + index, samples, first * sizeof(int16_t));
+        memcpy(m_buffer, samples + first, (count - first) * sizeof(int16_t));
+        
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+    
+    // Producer side, a contiguous free region to write in place, finished by commit_write()
+    int16_t* write_span(size_t *count) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        size_t index = head % m_capacity;
+        size_t free_count = m_capacity - (head - tail);
+        
+        *count = free_count < m_capacity - index ? free_count : m_capacity - index;
+        return m_buffer + index;
+    }
+    
+    void commit_write(size_t count) {
+        m_head.store(m_head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+    
+    // Consumer side, returns count of read samples
+    size_t read(int16_t *samples, size_t count) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_acquire);
+        
+        if (count > head - tail) {
+            count = head - tail;
+        }
+        
+        size_t index = tail % m_capacity;
+        size_t first = count < m_capacity - index ? count : m_capacity - index;
+        memcpy(samples, m_buffer + index, first * sizeof(int16_t));
+        memcpy(samples + first, m_buffer, (count - first) * sizeof(int16_t));
+        
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+    
+    // Consumer side, frees samples which was used in place
+    void consume(size_t count) {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+    
+private:
+    void release() {
+        if (m_buffer && m_owns_buffer) {
+            free(m_buffer);
+        }
+        m_buffer = nullptr;
+        m_capacity = 0;
+    }
+    
+    int16_t* m_buffer = nullptr;
+    bool m_owns_buffer = false;
+    size_t m_capacity = 0;
+    
+    // Each index is written by one side only, on the own cache line
+    alignas(64) std::atomic<size_t> m_head = {0};
+    alignas(64) std::atomic<size_t> m_tail = {0};
+};
@@ -6,6 +6,9 @@
 #include <malloc.h>
 #include <inttypes.h>
 
+// The sink is stereo, surround streams are downmixed
+#define OUTPUT_CHANNEL_COUNT 2
+
 static const uint8_t m_sink_channels[] = { 0, 1 };
 
 static const AudioRendererConfig m_ar_config =
@@ -19,20 +22,24 @@ static const AudioRendererConfig m_ar_config =
 };
 
 int AudrenAudioRenderer::init(int audio_configuration, const POPUS_MULTISTREAM_CONFIGURATION opus_config, void *context, int ar_flags) {
-    m_channel_count = opus_config->channelCount;
-    m_sample_rate = opus_config->sampleRate;
-    m_buffer_size = m_latency * m_samples_per_frame * sizeof(s16);
-    m_samples = m_buffer_size / m_channel_count / sizeof(s16);
-    m_current_size = 0;
-    
-    Logger::info("Audren", "Init with channels: %i, sample rate: %i", m_channel_count, m_sample_rate);
+    if (!m_pipeline.init(opus_config, OUTPUT_CHANNEL_COUNT, m_samples_per_frame)) {
+        return -1;
+    }
     
-    mutexInit(&m_update_lock);
+    m_channel_count = m_pipeline.channel_count();
+    m_sample_rate = m_pipeline.sample_rate();
     
-    m_decoded_buffer = (s16 *)malloc(m_channel_count * m_samples_per_frame * sizeof(s16));
+    // One wavebuf per audren frame, the queue latency is set by the jitter buffer.
+    // The mempool is the ring buffer, the wavebufs are played in place.
+    m_buffer_size = m_samples_per_frame * m_channel_count * sizeof(s16);
+    m_samples = m_samples_per_frame;
+    m_is_starved = true;
+    m_submitted_position = 0;
+    m_feeder_wake_ups = 0;
+    m_total_feeder_late_us = 0;
+    m_max_feeder_late_us = 0;
     
-    int error;
-    m_decoder = opus_multistream_decoder_create(opus_config->sampleRate, opus_config->channelCount, opus_config->streams, opus_config->coupledStreams, opus_config->mapping, &error);
+    Logger::info("Audren", "Init with channels: %i (output: %i), sample rate: %i", opus_config->channelCount, m_channel_count, m_sample_rate);
     
     memset(&m_driver, 0, sizeof(m_driver));
     memset(m_wavebufs, 0, sizeof(m_wavebufs));
@@ -45,6 +52,8 @@ int AudrenAudioRenderer::init(int audio_configuration, const POPUS_MULTISTREAM_C
         return -1;
     }
     
+    m_pipeline.ring_buffer().init((s16 *)mempool_ptr, BUFFER_COUNT * m_buffer_size / sizeof(s16));
+    
     Result rc = audrenInitialize(&m_ar_config);
     if (R_FAILED(rc)) {
         Logger::error("Audren", "audrenInitialize: %x", rc);
@@ -64,8 +73,6 @@ int AudrenAudioRenderer::init(int audio_configuration, const POPUS_MULTISTREAM_C
         m_wavebufs[i].end_sample_offset = m_wavebufs[i].start_sample_offset + m_samples;
     }
     
-    m_current_wavebuf = NULL;
-    
     int mpid = audrvMemPoolAdd(&m_driver, mempool_ptr, mempool_size);
     audrvMemPoolAttach(&m_driver, mpid);
     
@@ -94,23 +101,35 @@ int AudrenAudioRenderer::init(int audio_configuration, const POPUS_MULTISTREAM_C
     return DR_OK;
 }
 
-void AudrenAudioRenderer::cleanup() {
-    Logger::info("Audren", "Cleanup...");
+void AudrenAudioRenderer::start() {
+    m_feeder_is_running = true;
     
-    if (m_decoder) {
-        opus_multistream_decoder_destroy(m_decoder);
-        m_decoder = nullptr;
+    // Above the default priority, the feeder should not wait for UI
+    Result rc = threadCreate(&m_feeder_thread, feeder_entry, this, NULL, 0x4000, 0x2B, -2);
+    if (R_FAILED(rc)) {
+        Logger::error("Audren", "threadCreate: %x", rc);
+        m_feeder_is_running = false;
+        return;
     }
     
-    if (m_decoded_buffer) {
-        free(m_decoded_buffer);
-        m_decoded_buffer = nullptr;
+    m_feeder_thread_created = true;
+    threadStart(&m_feeder_thread);
+}
+
+void AudrenAudioRenderer::stop() {
+    if (m_feeder_thread_created) {
+        m_feeder_is_running = false;
+        threadWaitForExit(&m_feeder_thread);
+        threadClose(&m_feeder_thread);
+        m_feeder_thread_created = false;
     }
+}
+
+void AudrenAudioRenderer::cleanup() {
+    Logger::info("Audren", "Cleanup...");
     
-    if (mempool_ptr) {
-        free(mempool_ptr);
-        mempool_ptr = nullptr;
-    }
+    stop();
+    m_pipeline.cleanup();
     
     if (m_inited_driver) {
         m_inited_driver = false;
@@ -119,93 +138,103 @@ void AudrenAudioRenderer::cleanup() {
         audrenExit();
     }
     
+    if (mempool_ptr) {
+        m_pipeline.ring_buffer().init(nullptr, 0);
+        free(mempool_ptr);
+        mempool_ptr = nullptr;
+    }
+    
     Logger::info("Audren", "Cleanup done!");
 }
 
 void AudrenAudioRenderer::decode_and_play_sample(char *data, int length) {
-    if (m_decoder && m_decoded_buffer) {
-        if (data != NULL && length > 0) {
-            int decoded_samples = opus_multistream_decode(m_decoder, (const unsigned char *)data, length, m_decoded_buffer, m_samples_per_frame, 0);
-            
-            if (decoded_samples > 0) {
-                write_audio(m_decoded_buffer, decoded_samples * m_channel_count * sizeof(s16));
-            }
-        }
-    } else {
-        Logger::fatal("Audren", "Invalid call of decode_and_play_sample");
-    }
+    m_pipeline.decode_and_play_sample((const unsigned char *)data, length);
 }
 
 int AudrenAudioRenderer::capabilities() {
     return CAPABILITY_DIRECT_SUBMIT;
 }
 
-ssize_t AudrenAudioRenderer::free_wavebuf_index() {
-    for (int i = 0; i < BUFFER_COUNT; i++) {
-        if (m_wavebufs[i].state == AudioDriverWaveBufState_Free || m_wavebufs[i].state == AudioDriverWaveBufState_Done) {
-            return i;
+AudioRenderStats* AudrenAudioRenderer::audio_render_stats() {
+    m_pipeline.fill_stats(&m_audio_render_stats);
+    m_audio_render_stats.feeder_wake_ups = m_feeder_wake_ups;
+    m_audio_render_stats.total_feeder_late_us = m_total_feeder_late_us;
+    m_audio_render_stats.max_feeder_late_us = m_max_feeder_late_us;
+    return &m_audio_render_stats;
+}
+
+void AudrenAudioRenderer::set_latency_bounds(float min_ms, float max_ms) {
+    m_pipeline.set_latency_bounds(min_ms, max_ms);
+}
+
+void AudrenAudioRenderer::feeder_entry(void* context) {
+    if (auto renderer = static_cast<AudrenAudioRenderer *>(context)) {
+        renderer->feeder_loop();
+    }
+}
+
+void AudrenAudioRenderer::feeder_loop() {
+    // audren renders a frame every period and signals it, a wake up later than
+    // that comes from preemption or a slow update, and eats the queued wavebufs
+    const u64 frame_period_us = 1000000ULL * m_samples_per_frame / 48000;
+    u64 last_wake_up = 0;
+    
+    while (m_feeder_is_running) {
+        feed_wavebufs();
+        audrvUpdate(&m_driver);
+        audrenWaitFrame();
+        
+        u64 now = armGetSystemTick();
+        
+        if (last_wake_up != 0) {
+            u64 interval_us = armTicksToNs(now - last_wake_up) / 1000;
+            u64 late_us = interval_us > frame_period_us ? interval_us - frame_period_us : 0;
+            
+            m_feeder_wake_ups++;
+            m_total_feeder_late_us += late_us;
+            if (late_us > m_max_feeder_late_us) {
+                m_max_feeder_late_us = late_us;
+            }
         }
+        last_wake_up = now;
     }
-    return -1;
 }
 
-size_t AudrenAudioRenderer::append_audio(const void *buf, size_t size) {
-    ssize_t index = -1;
+void AudrenAudioRenderer::feed_wavebufs() {
+    const size_t wavebuf_samples = m_buffer_size / sizeof(s16);
+    AudioRingBuffer& ring_buffer = m_pipeline.ring_buffer();
     
-    if (!m_current_wavebuf) {
-        index = free_wavebuf_index();
-        if (index == -1) {
-            return 0;
+    // Release played wavebufs, in the order of submission
+    while (ring_buffer.read_position() < m_submitted_position) {
+        AudioDriverWaveBuf* wavebuf = &m_wavebufs[(ring_buffer.read_position() / wavebuf_samples) % BUFFER_COUNT];
+        
+        if (wavebuf->state != AudioDriverWaveBufState_Done) {
+            break;
         }
         
-        m_current_wavebuf = &m_wavebufs[index];
-        current_pool_ptr = mempool_ptr + (index * m_buffer_size);
-        m_current_size = 0;
+        ring_buffer.consume(wavebuf_samples);
     }
     
-    if (size > m_buffer_size - m_current_size) {
-        size = m_buffer_size - m_current_size;
+    // Submit wavebufs filled by the decoder, no copy here
+    while (ring_buffer.write_position() - m_submitted_position >= wavebuf_samples) {
+        int index = (m_submitted_position / wavebuf_samples) % BUFFER_COUNT;
+        armDCacheFlush((u8 *)mempool_ptr + index * m_buffer_size, m_buffer_size);
+        audrvVoiceAddWaveBuf(&m_driver, 0, &m_wavebufs[index]);
+        m_submitted_position += wavebuf_samples;
+        m_is_starved = false;
     }
     
-    void *dstbuf = current_pool_ptr + m_current_size;
-    memcpy(dstbuf, buf, size);
-    armDCacheFlush(dstbuf, size);
-    
-    m_current_size += size;
+    int queued_wavebufs = (m_submitted_position - ring_buffer.read_position()) / wavebuf_samples;
     
-    if (m_current_size == m_buffer_size) {
-        audrvVoiceAddWaveBuf(&m_driver, 0, m_current_wavebuf);
-        
-        mutexLock(&m_update_lock);
-        audrvUpdate(&m_driver);
-        mutexUnlock(&m_update_lock);
-        
-        if (!audrvVoiceIsPlaying(&m_driver, 0)) {
-            audrvVoiceStart(&m_driver, 0);
-        }
-        
-        m_current_wavebuf = NULL;
-    }
+    m_pipeline.device_queued_frames();
     
-    return size;
-}
-
-void AudrenAudioRenderer::write_audio(const void *buf, size_t size) {
-    if (!m_inited_driver) {
-        Logger::fatal("Audren", "Call write_audio without init driver!");
-        return;
+    // Count a starvation once, not every frame until the next packet
+    if (queued_wavebufs == 0 && !m_is_starved) {
+        m_is_starved = true;
+        m_pipeline.underrun_happened();
     }
     
-    size_t written = 0;
-    
-    while (written < size) {
-        written += append_audio(buf + written, size - written);
-        
-        if (written != size) {
-            mutexLock(&m_update_lock);
-            audrvUpdate(&m_driver);
-            mutexUnlock(&m_update_lock);
-            audrenWaitFrame();
-        }
+    if (queued_wavebufs > 0 && !audrvVoiceIsPlaying(&m_driver, 0)) {
+        audrvVoiceStart(&m_driver, 0);
     }
 }
@@ -1,9 +1,10 @@
 #include "IAudioRenderer.hpp"
-#include <opus/opus_multistream.h>
+#include "AudioPipeline.hpp"
 #include <switch.h>
+#include <atomic>
 #pragma once
 
-#define BUFFER_COUNT 5
+#define BUFFER_COUNT 40
 
 class AudrenAudioRenderer: public IAudioRenderer {
 public:
@@ -11,32 +12,43 @@ public:
     ~AudrenAudioRenderer() {};
     
     int init(int audio_configuration, const POPUS_MULTISTREAM_CONFIGURATION opus_config, void *context, int ar_flags) override;
+    void start() override;
+    void stop() override;
     void cleanup() override;
     void decode_and_play_sample(char *sample_data, int sample_length) override;
     int capabilities() override;
+    AudioRenderStats* audio_render_stats() override;
+    void set_latency_bounds(float min_ms, float max_ms) override;
     
 private:
-    ssize_t free_wavebuf_index();
-    size_t append_audio(const void *buf, size_t size);
-    void write_audio(const void *buf, size_t size);
+    static void feeder_entry(void* context);
+    void feeder_loop();
+    void feed_wavebufs();
     
-    OpusMSDecoder* m_decoder = nullptr;
-    s16* m_decoded_buffer = nullptr;
+    // Decodes into the ring, which is the mempool
+    AudioPipeline m_pipeline;
     void* mempool_ptr = nullptr;
-    void* current_pool_ptr = nullptr;
     
     AudioDriver m_driver;
     AudioDriverWaveBuf m_wavebufs[BUFFER_COUNT];
-    AudioDriverWaveBuf* m_current_wavebuf;
-    Mutex m_update_lock;
+    
+    Thread m_feeder_thread;
+    bool m_feeder_thread_created = false;
+    std::atomic<bool> m_feeder_is_running = {false};
+    bool m_is_starved = true;
     
     bool m_inited_driver = false;
     int m_channel_count = 0;
     int m_sample_rate = 0;
     int m_buffer_size = 0;
     int m_samples = 0;
-    ssize_t m_current_size = 0;
+    size_t m_submitted_position = 0;
+    
+    // Written by the feeder thread only, read by UI
+    std::atomic<uint32_t> m_feeder_wake_ups = {0};
+    std::atomic<uint64_t> m_total_feeder_late_us = {0};
+    std::atomic<uint64_t> m_max_feeder_late_us = {0};
+    AudioRenderStats m_audio_render_stats = {};
     
     const int m_samples_per_frame = AUDREN_SAMPLES_PER_FRAME_48KHZ;
-    const int m_latency = 5;
 };
@@ -1,7 +1,7 @@
 #include "DebugFileRecorderAudioRenderer.hpp"
 #include <cstdlib>
 
-#define MAX_CHANNEL_COUNT 6
+#define MAX_CHANNEL_COUNT 8
 #define FRAME_SIZE 240
 
 DebugFileRecorderAudioRenderer::~DebugFileRecorderAudioRenderer() {
@@ -12,6 +12,11 @@ int DebugFileRecorderAudioRenderer::init(int audio_configuration, const POPUS_MU
     int error;
     m_decoder = opus_multistream_decoder_create(opus_config->sampleRate, opus_config->channelCount, opus_config->streams, opus_config->coupledStreams, opus_config->mapping, &error);
     m_buffer = (short *)malloc(FRAME_SIZE * MAX_CHANNEL_COUNT * sizeof(short));
+    m_channel_count = opus_config->channelCount;
+    
+    if (m_enable) {
+        m_writer.open(m_path, opus_config->sampleRate, opus_config->channelCount);
+    }
     return DR_OK;
 }
 
@@ -25,19 +30,21 @@ void DebugFileRecorderAudioRenderer::cleanup() {
         free(m_buffer);
         m_buffer = nullptr;
     }
-
-    if (m_enable) {
-        m_data.write_to_file("/Users/rock88/Documents/Projects/RetroArch/audio.raw");
-    }
+    
+    m_writer.close();
 }
 
 void DebugFileRecorderAudioRenderer::decode_and_play_sample(char *data, int length) {
     int decode_len = opus_multistream_decode(m_decoder, (const unsigned char *)data, length, m_buffer, FRAME_SIZE, 0);
-    if (decode_len > 0 && m_enable) {
-        m_data = m_data.append(Data((char *)m_buffer, FRAME_SIZE * 2 * sizeof(short)));
+    if (decode_len > 0 && m_writer.is_open()) {
+        m_writer.write(m_buffer, decode_len * m_channel_count);
     }
 }
 
 int DebugFileRecorderAudioRenderer::capabilities() {
     return CAPABILITY_DIRECT_SUBMIT;
 }
+
+AudioRenderStats* DebugFileRecorderAudioRenderer::audio_render_stats() {
+    return &m_audio_render_stats;
+}
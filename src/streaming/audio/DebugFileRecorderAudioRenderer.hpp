@@ -1,21 +1,26 @@
 #include "IAudioRenderer.hpp"
+#include "WavFileWriter.hpp"
 #include <opus/opus_multistream.h>
-#include "Data.hpp"
+#include <string>
 #pragma once
 
 class DebugFileRecorderAudioRenderer: public IAudioRenderer {
 public:
-    DebugFileRecorderAudioRenderer(bool enable): m_enable(enable) {};
+    DebugFileRecorderAudioRenderer(bool enable, const std::string &path): m_enable(enable), m_path(path) {};
     ~DebugFileRecorderAudioRenderer();
     
     int init(int audio_configuration, const POPUS_MULTISTREAM_CONFIGURATION opus_config, void *context, int ar_flags) override;
     void cleanup() override;
     void decode_and_play_sample(char *sample_data, int sample_length) override;
     int capabilities() override;
+    AudioRenderStats* audio_render_stats() override;
     
 private:
     OpusMSDecoder* m_decoder = nullptr;
     short* m_buffer = nullptr;
+    int m_channel_count = 0;
     bool m_enable;
-    Data m_data;
+    std::string m_path;
+    WavFileWriter m_writer;
+    AudioRenderStats m_audio_render_stats = {};
 };
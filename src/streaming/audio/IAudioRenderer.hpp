@@ -1,6 +1,30 @@
 #include <Limelight.h>
 #pragma once
 
+struct AudioRenderStats {
+    uint32_t queued_samples; // Per channel
+    uint32_t underruns;
+    uint32_t overruns;
+    uint32_t dropped_packets; // Far above the target latency, after a burst
+    float latency_ms;
+    float target_latency_ms;
+    float jitter_ms;
+    float drift_ppm;
+    uint32_t lost_packets;
+    uint32_t concealed_frames; // Packet loss concealment
+    uint32_t fec_frames; // Recovered from in-band FEC
+    uint32_t downmixed_packets;
+    uint64_t total_downmix_time_ns;
+    uint32_t received_packets;
+    uint32_t decoded_packets;
+    uint64_t total_decode_time_us;
+    uint64_t max_decode_time_us;
+    uint32_t max_queued_samples; // Per channel
+    uint32_t feeder_wake_ups;
+    uint64_t total_feeder_late_us; // Past the audio frame period
+    uint64_t max_feeder_late_us;
+};
+
 class IAudioRenderer {
 public:
     virtual ~IAudioRenderer() {};
@@ -10,4 +34,8 @@ public:
     virtual void cleanup() = 0;
     virtual void decode_and_play_sample(char* sample_data, int sample_length) = 0;
     virtual int capabilities() = 0;
+    virtual AudioRenderStats* audio_render_stats() = 0;
+    
+    // Limits of the queue latency, used to keep audio in sync with video
+    virtual void set_latency_bounds(float min_ms, float max_ms) {};
 };
@@ -0,0 +1,110 @@
+#include "NullAudioRenderer.hpp"
+#include "Logger.hpp"
+#include <chrono>
+#include <stdlib.h>
+
+// The device consumes a period of an audren frame size, 5 ms at 48 kHz
+#define DEVICE_PERIOD_FRAMES 240
+#define RING_DURATION_MS 250
+
+// Like the audren sink, surround streams are downmixed
+#define OUTPUT_CHANNEL_COUNT 2
+
+NullAudioRenderer::~NullAudioRenderer() {
+    cleanup();
+}
+
+int NullAudioRenderer::init(int audio_configuration, const POPUS_MULTISTREAM_CONFIGURATION opus_config, void *context, int ar_flags) {
+    m_is_starved = true;
+    
+    if (!m_pipeline.init(opus_config, OUTPUT_CHANNEL_COUNT, DEVICE_PERIOD_FRAMES)) {
+        return -1;
+    }
+    
+    int channel_count = m_pipeline.channel_count();
+    int sample_rate = m_pipeline.sample_rate();
+    
+    Logger::info("NullAudio", "Init with channels: %i (output: %i), sample rate: %i", opus_config->channelCount, channel_count, sample_rate);
+    
+    if (!m_pipeline.ring_buffer().init(sample_rate * RING_DURATION_MS / 1000 * channel_count)) {
+        Logger::error("NullAudio", "Ring buffer alloc failed");
+        return -1;
+    }
+    
+    m_device_buffer = (int16_t *)malloc(DEVICE_PERIOD_FRAMES * channel_count * sizeof(int16_t));
+    
+    if (!m_device_buffer) {
+        Logger::error("NullAudio", "Device buffer alloc failed");
+        return -1;
+    }
+    return DR_OK;
+}
+
+void NullAudioRenderer::start() {
+    m_clock_is_running = true;
+    m_clock_thread = std::thread([this] {
+        clock_loop();
+    });
+}
+
+void NullAudioRenderer::stop() {
+    m_clock_is_running = false;
+    
+    if (m_clock_thread.joinable()) {
+        m_clock_thread.join();
+    }
+}
+
+void NullAudioRenderer::cleanup() {
+    stop();
+    m_pipeline.cleanup();
+    
+    if (m_device_buffer) {
+        free(m_device_buffer);
+        m_device_buffer = nullptr;
+    }
+}
+
+void NullAudioRenderer::decode_and_play_sample(char *data, int length) {
+    m_pipeline.decode_and_play_sample((const unsigned char *)data, length);
+}
+
+int NullAudioRenderer::capabilities() {
+    return CAPABILITY_DIRECT_SUBMIT;
+}
+
+AudioRenderStats* NullAudioRenderer::audio_render_stats() {
+    m_pipeline.fill_stats(&m_audio_render_stats);
+    return &m_audio_render_stats;
+}
+
+void NullAudioRenderer::set_latency_bounds(float min_ms, float max_ms) {
+    m_pipeline.set_latency_bounds(min_ms, max_ms);
+}
+
+void NullAudioRenderer::clock_loop() {
+    const size_t period_samples = DEVICE_PERIOD_FRAMES * m_pipeline.channel_count();
+    const auto period = std::chrono::microseconds(1000000LL * DEVICE_PERIOD_FRAMES / m_pipeline.sample_rate());
+    auto next_period = std::chrono::steady_clock::now() + period;
+    
+    while (m_clock_is_running) {
+        std::this_thread::sleep_until(next_period);
+        next_period += period;
+        
+        int queued = m_pipeline.device_queued_frames();
+        
+        // Like a device, start to play after the queue reached the target
+        if (m_is_starved && queued < m_pipeline.target_frames()) {
+            continue;
+        }
+        
+        if (m_pipeline.ring_buffer().read(m_device_buffer, period_samples) < period_samples) {
+            if (!m_is_starved) {
+                m_is_starved = true;
+                m_pipeline.underrun_happened();
+            }
+        } else {
+            m_is_starved = false;
+        }
+    }
+}
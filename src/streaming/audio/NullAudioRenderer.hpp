@@ -0,0 +1,34 @@
+#include "IAudioRenderer.hpp"
+#include "AudioPipeline.hpp"
+#include <atomic>
+#include <thread>
+#pragma once
+
+// Plays to nowhere: a thread consumes the ring at a simulated 48 kHz stereo device
+// clock, so the decode and buffering path of the audren sink can run and be
+// measured without audio hardware, e.g. in headless Linux runs.
+class NullAudioRenderer: public IAudioRenderer {
+public:
+    NullAudioRenderer() {};
+    ~NullAudioRenderer();
+    
+    int init(int audio_configuration, const POPUS_MULTISTREAM_CONFIGURATION opus_config, void *context, int ar_flags) override;
+    void start() override;
+    void stop() override;
+    void cleanup() override;
+    void decode_and_play_sample(char *sample_data, int sample_length) override;
+    int capabilities() override;
+    AudioRenderStats* audio_render_stats() override;
+    void set_latency_bounds(float min_ms, float max_ms) override;
+    
+private:
+    void clock_loop();
+    
+    AudioPipeline m_pipeline;
+    int16_t* m_device_buffer = nullptr;
+    
+    std::thread m_clock_thread;
+    std::atomic<bool> m_clock_is_running = {false};
+    bool m_is_starved = true;
+    AudioRenderStats m_audio_render_stats = {};
+};
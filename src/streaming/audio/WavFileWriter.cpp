@@ -0,0 +1,145 @@
+#include "WavFileWriter.hpp"
+#include "Logger.hpp"
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_DURATION_SEC 2
+#define CHUNK_SAMPLES 16384
+#define WRITER_INTERVAL_MS 20
+#define WAV_HEADER_SIZE 44
+
+static void put_u16(uint8_t *dst, uint16_t value) {
+    dst[0] = value & 0xFF;
+    dst[1] = (value >> 8) & 0xFF;
+}
+
+static void put_u32(uint8_t *dst, uint32_t value) {
+    put_u16(dst, value & 0xFFFF);
+    put_u16(dst + 2, value >> 16);
+}
+
+WavFileWriter::~WavFileWriter() {
+    close();
+}
+
+bool WavFileWriter::open(const std::string &path, int sample_rate, int channels) {
+    close();
+    
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file) {
+        Logger::error("WavFileWriter", "Can't open %s", path.c_str());
+        return false;
+    }
+    
+    m_path = path;
+    m_sample_rate = sample_rate;
+    m_channels = channels;
+    m_data_size = 0;
+    m_dropped_samples = 0;
+    
+    if (!m_ring_buffer.init(RING_DURATION_SEC * sample_rate * channels)) {
+        Logger::error("WavFileWriter", "Ring buffer alloc failed");
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    
+    m_chunk = (int16_t *)malloc(CHUNK_SAMPLES * sizeof(int16_t));
+    
+    if (!m_chunk) {
+        Logger::error("WavFileWriter", "Chunk alloc failed");
+        m_ring_buffer.init(nullptr, 0);
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    
+    // Sizes are unknown until close
+    write_header(0);
+    
+    m_is_running = true;
+    m_thread = std::thread([this] {
+        writer_loop();
+    });
+    
+    Logger::info("WavFileWriter", "Recording to %s", path.c_str());
+    return true;
+}
+
+void WavFileWriter::close() {
+    if (!m_file) {
+        return;
+    }
+    
+    m_is_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    
+    while (flush_ring() > 0) {}
+    
+    // The RIFF sizes are 32 bit, a longer recording keeps the maximum
+    write_header(m_data_size > UINT32_MAX - WAV_HEADER_SIZE ? UINT32_MAX - WAV_HEADER_SIZE : (uint32_t)m_data_size);
+    fclose(m_file);
+    m_file = nullptr;
+    
+    if (m_chunk) {
+        free(m_chunk);
+        m_chunk = nullptr;
+    }
+    
+    Logger::info("WavFileWriter", "Closed %s, %llu bytes, %llu samples dropped", m_path.c_str(), (unsigned long long)m_data_size, (unsigned long long)m_dropped_samples.load());
+}
+
+size_t WavFileWriter::write(const int16_t *samples, size_t count) {
+    if (!m_file) {
+        return 0;
+    }
+    
+    size_t written = m_ring_buffer.write(samples, count);
+    if (written < count) {
+        m_dropped_samples += count - written;
+    }
+    return written;
+}
+
+void WavFileWriter::writer_loop() {
+    while (m_is_running) {
+        if (flush_ring() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_INTERVAL_MS));
+        }
+    }
+}
+
+size_t WavFileWriter::flush_ring() {
+    size_t count = m_ring_buffer.read(m_chunk, CHUNK_SAMPLES);
+    
+    if (count > 0) {
+        fwrite(m_chunk, sizeof(int16_t), count, m_file);
+        m_data_size += count * sizeof(int16_t);
+    }
+    return count;
+}
+
+void WavFileWriter::write_header(uint32_t data_size) {
+    uint8_t header[WAV_HEADER_SIZE];
+    
+    memcpy(header, "RIFF", 4);
+    put_u32(header + 4, WAV_HEADER_SIZE - 8 + data_size);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    put_u32(header + 16, 16);
+    put_u16(header + 20, 1); // PCM
+    put_u16(header + 22, m_channels);
+    put_u32(header + 24, m_sample_rate);
+    put_u32(header + 28, m_sample_rate * m_channels * sizeof(int16_t));
+    put_u16(header + 32, m_channels * sizeof(int16_t));
+    put_u16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    put_u32(header + 40, data_size);
+    
+    fseek(m_file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), m_file);
+    fseek(m_file, 0, SEEK_END);
+}
@@ -0,0 +1,46 @@
+#include "AudioRingBuffer.hpp"
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#pragma once
+
+// Streams s16 PCM into a WAV file from a background thread, with a bounded
+// memory. write() never blocks on the file, samples are dropped if the disk
+// can't keep up. The header sizes are patched on close().
+class WavFileWriter {
+public:
+    WavFileWriter() {};
+    ~WavFileWriter();
+    
+    bool open(const std::string &path, int sample_rate, int channels);
+    void close();
+    
+    // Returns a count of written samples
+    size_t write(const int16_t *samples, size_t count);
+    
+    bool is_open() const {
+        return m_file != nullptr;
+    }
+    
+    uint64_t dropped_samples() const {
+        return m_dropped_samples;
+    }
+    
+private:
+    void writer_loop();
+    size_t flush_ring();
+    void write_header(uint32_t data_size);
+    
+    FILE* m_file = nullptr;
+    std::string m_path;
+    int m_sample_rate = 0;
+    int m_channels = 0;
+    uint64_t m_data_size = 0;
+    
+    AudioRingBuffer m_ring_buffer;
+    int16_t* m_chunk = nullptr;
+    std::thread m_thread;
+    std::atomic<bool> m_is_running = {false};
+    std::atomic<uint64_t> m_dropped_samples = {0};
+};
@@ -10,6 +10,19 @@
 
 #define DECODER_BUFFER_SIZE 92 * 1024 * 2
 
+static const char* video_format_name(int video_format) {
+    switch (video_format) {
+        case VIDEO_FORMAT_H264:
+            return "H264";
+        case VIDEO_FORMAT_H265:
+            return "HEVC";
+        case VIDEO_FORMAT_H265_MAIN10:
+            return "HEVC Main10";
+        default:
+            return "Unknown";
+    }
+}
+
 FFmpegVideoDecoder::FFmpegVideoDecoder() {}
 
 FFmpegVideoDecoder::~FFmpegVideoDecoder() {}
@@ -17,7 +30,7 @@ FFmpegVideoDecoder::~FFmpegVideoDecoder() {}
 int FFmpegVideoDecoder::setup(int video_format, int width, int height, int redraw_rate, void *context, int dr_flags) {
     m_stream_fps = redraw_rate;
     
-    Logger::info("FFmpeg", "Setup with format: %s, width: %i, height: %i, fps: %i", video_format == VIDEO_FORMAT_H264 ? "H264" : "HEVC", width, height, redraw_rate);
+    Logger::info("FFmpeg", "Setup with format: %s, width: %i, height: %i, fps: %i", video_format_name(video_format), width, height, redraw_rate);
     
     av_log_set_level(AV_LOG_QUIET);
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58,10,100)
@@ -28,13 +41,10 @@ int FFmpegVideoDecoder::setup(int video_format, int width, int height, int redra
     
     int perf_lvl = LOW_LATENCY_DECODE;
     
-    switch (video_format) {
-        case VIDEO_FORMAT_H264:
-            m_decoder = avcodec_find_decoder_by_name("h264");
-            break;
-        case VIDEO_FORMAT_H265:
-            m_decoder = avcodec_find_decoder_by_name("hevc");
-            break;
+    if (video_format & VIDEO_FORMAT_MASK_H264) {
+        m_decoder = avcodec_find_decoder_by_name("h264");
+    } else if (video_format & VIDEO_FORMAT_MASK_H265) {
+        m_decoder = avcodec_find_decoder_by_name("hevc");
     }
     
     if (m_decoder == NULL) {
@@ -67,7 +77,7 @@ int FFmpegVideoDecoder::setup(int video_format, int width, int height, int redra
     
     m_decoder_context->width = width;
     m_decoder_context->height = height;
-    m_decoder_context->pix_fmt = AV_PIX_FMT_YUV420P;
+    m_decoder_context->pix_fmt = video_format == VIDEO_FORMAT_H265_MAIN10 ? AV_PIX_FMT_YUV420P10 : AV_PIX_FMT_YUV420P;
     
     int err = avcodec_open2(m_decoder_context, m_decoder, NULL);
     if (err < 0) {
@@ -170,6 +180,9 @@ int FFmpegVideoDecoder::submit_decode_unit(PDECODE_UNIT decode_unit) {
             Logger::error("FFmpeg", "Big buffer to decode...");
         }
         
+        // The receive time goes with the frame, for the A/V offset measurement
+        m_packet.pts = decode_unit->receiveTimeMs;
+        
         if (decode(m_ffmpeg_buffer, length) == 0) {
             m_frames_out++;
             m_video_decode_stats.total_decode_time += LiGetMillis() - before_decode;
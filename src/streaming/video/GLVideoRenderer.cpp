@@ -1,5 +1,13 @@
 #include "GLVideoRenderer.hpp"
 #include "Logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+extern "C" {
+    #include <libavutil/pixdesc.h>
+}
 
 static const char *vertex_shader_string = "\
 #version 140\n\
@@ -18,17 +26,42 @@ uniform lowp sampler2D umap;\n\
 uniform lowp sampler2D vmap;\n\
 uniform mat3 yuvmat;\n\
 uniform vec3 offset;\n\
+uniform float bit_scale;\n\
+uniform int transfer;\n\
 in mediump vec2 tex_position;\n\
 out vec4 FragColor;\n\
 \
+const mat3 bt2020_to_bt709 = mat3(\n\
+1.6605, -0.1246, -0.0182,\n\
+-0.5876, 1.1329, -0.1006,\n\
+-0.0728, -0.0083, 1.1187\n\
+);\n\
+const float sdr_white_nits = 203.0;\n\
+const float peak_nits = 1000.0;\n\
+\
+vec3 pq_to_nits(vec3 pq) {\n\
+vec3 e = pow(max(pq, 0.0), vec3(1.0 / 78.84375));\n\
+return 10000.0 * pow(max(e - 0.8359375, 0.0) / (18.8515625 - 18.6875 * e), vec3(1.0 / 0.1593017578125));\n\
+}\n\
+\
+vec3 tone_map_pq(vec3 rgb) {\n\
+vec3 linear = max(bt2020_to_bt709 * (pq_to_nits(rgb) / sdr_white_nits), 0.0);\n\
+float luma = dot(linear, vec3(0.2126, 0.7152, 0.0722));\n\
+float white = peak_nits / sdr_white_nits;\n\
+float mapped = luma * (1.0 + luma / (white * white)) / (1.0 + luma);\n\
+linear *= luma > 0.0 ? mapped / luma : 0.0;\n\
+return pow(clamp(linear, 0.0, 1.0), vec3(1.0 / 2.2));\n\
+}\n\
+\
 void main() {\n\
 vec3 YCbCr = vec3(\n\
 texture(ymap, tex_position).r,\n\
 texture(umap, tex_position).r - 0.0,\n\
 texture(vmap, tex_position).r - 0.0\n\
 );\n\
-YCbCr -= offset;\n\
-FragColor = vec4(clamp(yuvmat * YCbCr, 0.0, 1.0), 1.0);\n\
+YCbCr = YCbCr * bit_scale - offset;\n\
+vec3 rgb = clamp(yuvmat * YCbCr, 0.0, 1.0);\n\
+FragColor = vec4(transfer == 1 ? tone_map_pq(rgb) : rgb, 1.0);\n\
 }";
 
 static const float vertices[] = {
@@ -40,6 +73,23 @@ static const float vertices[] = {
 
 static const char* texture_mappings[] = { "ymap", "umap", "vmap" };
 
+static uint64_t get_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 10 bit samples are stored in the low bits of 16 bit texels. 10 bit codes are
+// 8 bit codes multiplied by 4, so normalize them by 255 * 4 instead of 1023 and
+// the same offsets and matrices can be used for both bit depths.
+static float gl_bit_scale(bool is_10bit) {
+    return is_10bit ? 65535.0f / (255.0f * 4.0f) : 1.0f;
+}
+
+// HDR streams are SMPTE 2084 (PQ) with BT.2020 primaries, the shader tone maps them
+// to the SDR BT.709 output. Other transfers are drawn as they are.
+static int gl_transfer(enum AVColorTransferCharacteristic color_trc) {
+    return color_trc == AVCOL_TRC_SMPTE2084 ? 1 : 0;
+}
+
 static const float* gl_color_offset(bool color_full) {
     static const float limitedOffsets[] = { 16.0f / 255.0f, 128.0f / 255.0f, 128.0f / 255.0f };
     static const float fullOffsets[] = { 0.0f, 128.0f / 255.0f, 128.0f / 255.0f };
@@ -107,6 +157,10 @@ GLVideoRenderer::~GLVideoRenderer() {
         glDeleteVertexArrays(1, &m_vao);
     }
     
+    if (m_pbo) {
+        glDeleteBuffers(1, &m_pbo);
+    }
+    
     for (int i = 0; i < 3; i++) {
         if (m_texture_id[i]) {
             glDeleteTextures(1, &m_texture_id[i]);
@@ -127,6 +181,15 @@ void GLVideoRenderer::initialize() {
     glShaderSource(frag, 1, &fragment_shader_string, 0);
     glCompileShader(frag);
     
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(frag, GL_COMPILE_STATUS, &compiled);
+    
+    if (!compiled) {
+        char log[1024];
+        glGetShaderInfoLog(frag, sizeof(log), NULL, log);
+        Logger::error("GL", "Fragment shader compile failed: %s", log);
+    }
+    
     glAttachShader(m_shader_program, vert);
     glAttachShader(m_shader_program, frag);
     glLinkProgram(m_shader_program);
@@ -152,6 +215,99 @@ void GLVideoRenderer::initialize() {
     
     m_yuvmat_location = glGetUniformLocation(m_shader_program, "yuvmat");
     m_offset_location = glGetUniformLocation(m_shader_program, "offset");
+    m_bit_scale_location = glGetUniformLocation(m_shader_program, "bit_scale");
+    m_transfer_location = glGetUniformLocation(m_shader_program, "transfer");
+    
+    if (m_use_pbo) {
+        glGenBuffers(1, &m_pbo);
+    }
+}
+
+void GLVideoRenderer::update_viewport(int width, int height) {
+    m_surface_width = width;
+    m_surface_height = height;
+    
+    float scale = std::min((float)width / m_width, (float)height / m_height);
+    int viewport_width = std::min((int)roundf(m_width * scale), width);
+    int viewport_height = std::min((int)roundf(m_height * scale), height);
+    
+    m_viewport[0] = (width - viewport_width) / 2;
+    m_viewport[1] = (height - viewport_height) / 2;
+    m_viewport[2] = viewport_width;
+    m_viewport[3] = viewport_height;
+    
+    Logger::info("GL", "Viewport: %ix%i at %i,%i for output %ix%i", viewport_width, viewport_height, m_viewport[0], m_viewport[1], width, height);
+}
+
+void GLVideoRenderer::clear_letterbox() {
+    if (m_viewport[2] == m_surface_width && m_viewport[3] == m_surface_height) {
+        // Video covers the whole surface, nothing to clear
+        return;
+    }
+    
+    glClearColor(0, 0, 0, 1);
+    glEnable(GL_SCISSOR_TEST);
+    
+    if (m_viewport[0] > 0) {
+        glScissor(0, 0, m_viewport[0], m_surface_height);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glScissor(m_viewport[0] + m_viewport[2], 0, m_surface_width - m_viewport[0] - m_viewport[2], m_surface_height);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    
+    if (m_viewport[1] > 0) {
+        glScissor(0, 0, m_surface_width, m_viewport[1]);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glScissor(0, m_viewport[1] + m_viewport[3], m_surface_width, m_surface_height - m_viewport[1] - m_viewport[3]);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void GLVideoRenderer::upload_planes(AVFrame *frame) {
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, m_texture_id[i]);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[i] / m_bytes_per_pixel);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane_width(i), plane_height(i), GL_RED, m_texture_type, frame->data[i]);
+    }
+}
+
+void GLVideoRenderer::upload_planes_with_pbo(AVFrame *frame) {
+    size_t offsets[3];
+    size_t total_size = 0;
+    
+    for (int i = 0; i < 3; i++) {
+        offsets[i] = total_size;
+        total_size += frame->linesize[i] * plane_height(i);
+    }
+    
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+    
+    // Orphan the previous storage, so the driver doesn't have to wait
+    // until the last frame upload is finished before we can write again
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, total_size, NULL, GL_STREAM_DRAW);
+    
+    if (auto buffer = (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)) {
+        for (int i = 0; i < 3; i++) {
+            memcpy(buffer + offsets[i], frame->data[i], frame->linesize[i] * plane_height(i));
+        }
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, m_texture_id[i]);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[i] / m_bytes_per_pixel);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane_width(i), plane_height(i), GL_RED, m_texture_type, (void *)offsets[i]);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else {
+        Logger::error("GL", "Failed to map PBO, fallback to direct upload");
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        upload_planes(frame);
+    }
 }
 
 void GLVideoRenderer::draw(int width, int height, AVFrame *frame) {
@@ -162,7 +318,7 @@ void GLVideoRenderer::draw(int width, int height, AVFrame *frame) {
     uint64_t before_render = LiGetMillis();
     
     if (!m_is_initialized) {
-        Logger::info("GL", "Init with width: %i, height: %i", width, height);
+        Logger::info("GL", "Init with width: %i, height: %i, PBO: %s", width, height, m_use_pbo ? "on" : "off");
         
         initialize();
         m_is_initialized = true;
@@ -170,9 +326,24 @@ void GLVideoRenderer::draw(int width, int height, AVFrame *frame) {
         Logger::info("GL", "Init done");
     }
     
-    if (m_width != frame->width || m_height != frame->height) {
+    if (m_width != frame->width || m_height != frame->height || m_format != frame->format) {
         m_width = frame->width;
         m_height = frame->height;
+        m_format = frame->format;
+        
+        if (m_format == AV_PIX_FMT_YUV420P10) {
+            m_texture_internal_format = GL_R16;
+            m_texture_type = GL_UNSIGNED_SHORT;
+            m_bytes_per_pixel = 2;
+        } else {
+            m_texture_internal_format = GL_RED;
+            m_texture_type = GL_UNSIGNED_BYTE;
+            m_bytes_per_pixel = 1;
+        }
+        
+        Logger::info("GL", "Create textures with width: %i, height: %i, format: %s", m_width, m_height, av_get_pix_fmt_name((AVPixelFormat)m_format));
+        
+        m_viewport_needs_update = true;
         
         for (int i = 0; i < 3; i++) {
             if (m_texture_id[i]) {
@@ -186,32 +357,65 @@ void GLVideoRenderer::draw(int width, int height, AVFrame *frame) {
             glBindTexture(GL_TEXTURE_2D, m_texture_id[i]);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, i > 0 ? m_width / 2 : m_width, i > 0 ? m_height / 2 : m_height, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+            glTexImage2D(GL_TEXTURE_2D, 0, m_texture_internal_format, plane_width(i), plane_height(i), 0, GL_RED, m_texture_type, NULL);
         }
     }
     
-    glClearColor(0, 0, 0, 1);
-    glClear(GL_COLOR_BUFFER_BIT);
+    if (m_surface_width != width || m_surface_height != height || m_viewport_needs_update) {
+        m_viewport_needs_update = false;
+        update_viewport(width, height);
+    }
+    
+    clear_letterbox();
     
     glUseProgram(m_shader_program);
     
+    glUniform1f(m_bit_scale_location, gl_bit_scale(m_bytes_per_pixel == 2));
     glUniform3fv(m_offset_location, 1, gl_color_offset(frame->color_range == AVCOL_RANGE_JPEG));
     glUniformMatrix3fv(m_yuvmat_location, 1, GL_FALSE, gl_color_matrix(frame->colorspace, frame->color_range == AVCOL_RANGE_JPEG));
     
+    int transfer = gl_transfer(frame->color_trc);
+    if (transfer != m_transfer) {
+        m_transfer = transfer;
+        Logger::info("GL", "Transfer: %s", transfer == 1 ? "PQ, tone mapped to SDR" : "SDR");
+    }
+    glUniform1i(m_transfer_location, transfer);
+    
+    uint64_t before_upload = get_time_us();
+    
+    if (m_use_pbo) {
+        upload_planes_with_pbo(frame);
+    } else {
+        upload_planes(frame);
+    }
+    
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    
+    uint64_t before_draw = get_time_us();
+    
     for (int i = 0; i < 3; i++) {
-        auto image = frame->data[i];
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, m_texture_id[i]);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, i > 0 ? m_width / 2 : m_width, i > 0 ? m_height / 2 : m_height, GL_RED, GL_UNSIGNED_BYTE, image);
         glUniform1i(m_texture_uniform[i], i);
-        glActiveTexture(GL_TEXTURE0);
     }
+    glActiveTexture(GL_TEXTURE0);
     
+    glViewport(m_viewport[0], m_viewport[1], m_viewport[2], m_viewport[3]);
     glBindVertexArray(m_vao);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glViewport(0, 0, m_surface_width, m_surface_height);
+    
+    uint64_t after_draw = get_time_us();
     
+    m_video_render_stats.total_upload_time_us += before_draw - before_upload;
+    m_video_render_stats.total_draw_time_us += after_draw - before_draw;
     m_video_render_stats.total_render_time += LiGetMillis() - before_render;
     m_video_render_stats.rendered_frames++;
+    
+    // A frame is drawn until the next one is decoded, count the first draw only
+    if (frame->pts != AV_NOPTS_VALUE && frame->pts != m_last_frame_pts) {
+        float latency = (float)(LiGetMillis() - frame->pts);
+        m_video_render_stats.frame_latency_ms = m_last_frame_pts == AV_NOPTS_VALUE ? latency : m_video_render_stats.frame_latency_ms + (latency - m_video_render_stats.frame_latency_ms) / 8;
+        m_last_frame_pts = frame->pts;
+    }
 }
 
 VideoRenderStats* GLVideoRenderer::video_render_stats() {
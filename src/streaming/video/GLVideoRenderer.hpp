@@ -4,7 +4,7 @@
 
 class GLVideoRenderer: public IVideoRenderer {
 public:
-    GLVideoRenderer() {};
+    GLVideoRenderer(bool use_pbo = false): m_use_pbo(use_pbo) {};
     ~GLVideoRenderer();
     
     void draw(int width, int height, AVFrame *frame) override;
@@ -13,12 +13,35 @@ public:
     
 private:
     void initialize();
+    void update_viewport(int width, int height);
+    void clear_letterbox();
+    void upload_planes(AVFrame *frame);
+    void upload_planes_with_pbo(AVFrame *frame);
+    
+    int plane_width(int plane) const {
+        return plane > 0 ? m_width / 2 : m_width;
+    }
+    
+    int plane_height(int plane) const {
+        return plane > 0 ? m_height / 2 : m_height;
+    }
     
     bool m_is_initialized = false;
+    bool m_use_pbo = false;
+    bool m_viewport_needs_update = true;
     GLuint m_texture_id[3] = {0, 0, 0}, m_texture_uniform[3];
     GLuint m_shader_program;
     GLuint m_vbo, m_vao;
+    GLuint m_pbo = 0;
     int m_width = 0, m_height = 0;
-    int m_yuvmat_location, m_offset_location;
+    int m_surface_width = 0, m_surface_height = 0;
+    int m_viewport[4] = {0, 0, 0, 0};
+    int m_format = AV_PIX_FMT_NONE;
+    GLint m_texture_internal_format = GL_RED;
+    GLenum m_texture_type = GL_UNSIGNED_BYTE;
+    int m_bytes_per_pixel = 1;
+    int m_yuvmat_location, m_offset_location, m_bit_scale_location, m_transfer_location;
+    int m_transfer = 0;
+    int64_t m_last_frame_pts = AV_NOPTS_VALUE;
     VideoRenderStats m_video_render_stats = {};
 };
@@ -8,13 +8,18 @@ extern "C" {
 struct VideoRenderStats {
     uint32_t rendered_frames;
     uint64_t total_render_time;
+    uint64_t total_upload_time_us;
+    uint64_t total_draw_time_us;
     float rendered_fps;
+    float frame_latency_ms; // From receive to the first draw, smoothed
     double measurement_start_timestamp;
 };
 
 class IVideoRenderer {
 public:
     virtual ~IVideoRenderer() {};
+    
+    // width and height is a size of the output framebuffer, not a stream size
     virtual void draw(int width, int height, AVFrame* frame) = 0;
     virtual VideoRenderStats* video_render_stats() = 0;
 };
@@ -0,0 +1,309 @@
+#include "StatsOverlay.hpp"
+#include "MouseController.hpp"
+#include "Settings.hpp"
+#include <nanogui/nanogui.h>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdarg.h>
+
+#define NANOVG_GL3
+#include "nanovg_gl.h"
+
+using namespace nanogui;
+
+// Rebuild the text at 4 Hz, the values are averages anyway
+#define STATS_UPDATE_INTERVAL_MS 250
+
+#define GRAPH_HEIGHT 60
+#define GRAPH_MAX_FRAME_TIME 50.0f
+
+static uint64_t get_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+StatsOverlay::~StatsOverlay() {
+    if (m_image) {
+        // Deletes m_texture as well
+        nvgDeleteImage(m_ctx, m_image);
+    }
+    
+    if (m_framebuffer) {
+        glDeleteFramebuffers(1, &m_framebuffer);
+    }
+}
+
+void StatsOverlay::frame_tick() {
+    uint64_t now = get_time_us();
+    
+    if (m_last_frame_timestamp != 0) {
+        m_frame_times[m_frame_time_index] = (float)(now - m_last_frame_timestamp) / 1000;
+        m_frame_time_index = (m_frame_time_index + 1) % STATS_OVERLAY_FRAME_TIME_COUNT;
+        m_frame_time_count = std::min(m_frame_time_count + 1, STATS_OVERLAY_FRAME_TIME_COUNT);
+    }
+    
+    m_last_frame_timestamp = now;
+}
+
+int StatsOverlay::append_text(int offset, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(&m_text[offset], sizeof(m_text) - offset, format, args);
+    va_end(args);
+    
+    // snprintf returns the untruncated length, keep the offset inside of m_text
+    return std::min(offset + std::max(length, 0), (int)sizeof(m_text) - 1);
+}
+
+int StatsOverlay::update_audio_text(int offset, AudioRenderStats *stats) {
+    float decoded_packets = std::max(stats->decoded_packets, 1u);
+    float feeder_wake_ups = std::max(stats->feeder_wake_ups, 1u);
+    
+    offset = append_text(offset,
+                         "音频包: %u (平均解码时间: %.2f 毫秒, 最大: %.2f 毫秒)\n"
+                         "音频队列: %u 帧 (最大: %u 帧), 欠载: %u, 溢出: %u, 丢弃: %u\n"
+                         "音频延迟: %.1f 毫秒 (目标: %.1f 毫秒, 抖动: %.1f 毫秒, 漂移: %.0f ppm)\n"
+                         "音频丢包: %u (丢包隐藏: %u, FEC 恢复: %u)\n",
+                         stats->received_packets,
+                         stats->total_decode_time_us / 1000.0f / decoded_packets,
+                         stats->max_decode_time_us / 1000.0f,
+                         stats->queued_samples,
+                         stats->max_queued_samples,
+                         stats->underruns,
+                         stats->overruns,
+                         stats->dropped_packets,
+                         stats->latency_ms,
+                         stats->target_latency_ms,
+                         stats->jitter_ms,
+                         stats->drift_ppm,
+                         stats->lost_packets,
+                         stats->concealed_frames,
+                         stats->fec_frames);
+    
+    if (stats->feeder_wake_ups > 0) {
+        offset = append_text(offset,
+                             "音频线程唤醒延迟: %.2f 毫秒 (最大: %.2f 毫秒)\n",
+                             stats->total_feeder_late_us / 1000.0f / feeder_wake_ups,
+                             stats->max_feeder_late_us / 1000.0f);
+    }
+    
+    if (stats->downmixed_packets > 0) {
+        offset = append_text(offset,
+                             "音频缩混时间: %.2f 微秒/包\n",
+                             (float)stats->total_downmix_time_ns / 1000 / stats->downmixed_packets);
+    }
+    return offset;
+}
+
+void StatsOverlay::update_text(NVGcontext *ctx, SessionStats *stats) {
+    int offset = 0;
+    
+    offset = append_text(offset,
+                         "估计主机帧率: %.2f FPS\n"
+                         "网络输入帧率: %.2f FPS\n"
+                         "解码器帧率: %.2f FPS\n"
+                         "渲染帧率: %.2f FPS\n",
+                         stats->video_decode_stats.total_fps,
+                         stats->video_decode_stats.received_fps,
+                         stats->video_decode_stats.decoded_fps,
+                         stats->video_render_stats.rendered_fps);
+    
+    offset = append_text(offset,
+                         "网络连接掉帧: %.2f%% (Total: %u)\n"
+                         "平均接收时间: %.2f 毫秒\n"
+                         "平均解码时间: %.2f 毫秒\n"
+                         "平均渲染时间: %.2f 毫秒\n"
+                         "平均上传/绘制时间: %.2f / %.2f 毫秒\n",
+                         (float)stats->video_decode_stats.network_dropped_frames / stats->video_decode_stats.total_frames * 100,
+                         stats->video_decode_stats.network_dropped_frames,
+                         (float)stats->video_decode_stats.total_reassembly_time / stats->video_decode_stats.received_frames,
+                         (float)stats->video_decode_stats.total_decode_time / stats->video_decode_stats.decoded_frames,
+                         (float)stats->video_render_stats.total_render_time / stats->video_render_stats.rendered_frames,
+                         (float)stats->video_render_stats.total_upload_time_us / 1000 / stats->video_render_stats.rendered_frames,
+                         (float)stats->video_render_stats.total_draw_time_us / 1000 / stats->video_render_stats.rendered_frames);
+    
+    offset = append_text(offset,
+                         "音视频偏移: %+.1f 毫秒 (视频延迟: %.1f 毫秒)\n",
+                         stats->av_offset_ms,
+                         stats->video_render_stats.frame_latency_ms);
+    
+    offset = update_audio_text(offset, &stats->audio_render_stats);
+    
+    if (MouseController::instance().cursor_is_visible() &&
+        stats->video_decode_stats.received_frames > 0 &&
+        stats->video_decode_stats.decoded_frames > 0 &&
+        stats->video_render_stats.rendered_frames > 0) {
+        // The local cursor skips receive, decode, render and at least one frame
+        // interval of the host's cursor, the network round trip is not included
+        float hidden_latency = (float)stats->video_decode_stats.total_reassembly_time / stats->video_decode_stats.received_frames +
+                               (float)stats->video_decode_stats.total_decode_time / stats->video_decode_stats.decoded_frames +
+                               (float)stats->video_render_stats.total_render_time / stats->video_render_stats.rendered_frames +
+                               1000.0f / Settings::instance().fps();
+        
+        offset = append_text(offset,
+                             "本地光标隐藏延迟: 约 %.2f 毫秒\n",
+                             hidden_latency);
+    }
+    
+    // Only the filled slots, the ring is zeroed at the start
+    float total_frame_time = 0, max_frame_time = 0;
+    for (int i = 0; i < m_frame_time_count; i++) {
+        total_frame_time += m_frame_times[i];
+        max_frame_time = std::max(max_frame_time, m_frame_times[i]);
+    }
+    
+    offset = append_text(offset,
+                         "帧时间: %.2f 毫秒 (最大: %.2f 毫秒)",
+                         total_frame_time / std::max(m_frame_time_count, 1),
+                         max_frame_time);
+    
+    // Break lines once here, so drawing doesn't need a text layout each frame
+    nvgTextMetrics(ctx, NULL, NULL, &m_line_height);
+    m_rows_count = nvgTextBreakLines(ctx, m_text, NULL, 10000, m_rows, STATS_OVERLAY_MAX_ROWS);
+    
+    m_text_width = 0;
+    for (int i = 0; i < m_rows_count; i++) {
+        m_text_width = std::max(m_text_width, m_rows[i].width);
+    }
+}
+
+void StatsOverlay::render_text(Screen *screen) {
+    auto ctx = screen->nvg_context();
+    float pixel_ratio = screen->pixel_ratio();
+    
+    int width = (int)ceilf(m_text_width);
+    int height = (int)ceilf(m_line_height * m_rows_count);
+    
+    if (width > m_texture_width || height > m_texture_height) {
+        if (m_image) {
+            nvgDeleteImage(ctx, m_image);
+        } else {
+            glGenFramebuffers(1, &m_framebuffer);
+        }
+        
+        // Grow only, the text width changes with the values
+        m_texture_width = std::max(width, m_texture_width);
+        m_texture_height = std::max(height, m_texture_height);
+        
+        glGenTextures(1, &m_texture);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_texture_width * pixel_ratio, m_texture_height * pixel_ratio, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        
+        m_ctx = ctx;
+        m_image = nvglCreateImageFromHandleGL3(ctx, m_texture, m_texture_width * pixel_ratio, m_texture_height * pixel_ratio, NVG_IMAGE_FLIPY | NVG_IMAGE_PREMULTIPLIED);
+    }
+    
+    // Draw everything queued so far into the current framebuffer, before switching it
+    screen->nvg_flush();
+    
+    GLint framebuffer, viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture, 0);
+    glViewport(0, 0, m_texture_width * pixel_ratio, m_texture_height * pixel_ratio);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    
+    NVGparams *params = nvgInternalParams(ctx);
+    params->renderViewport(params->userPtr, m_texture_width, m_texture_height, pixel_ratio);
+    
+    nvgSave(ctx);
+    nvgReset(ctx);
+    
+    nvgFontFace(ctx, "sans-bold");
+    nvgFontSize(ctx, 20);
+    nvgFontBlur(ctx, 0);
+    nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+    nvgFillColor(ctx, Color(0, 255, 0, 255));
+    
+    for (int i = 0; i < m_rows_count; i++) {
+        nvgText(ctx, 0, i * m_line_height, m_rows[i].start, m_rows[i].end);
+    }
+    
+    nvgRestore(ctx);
+    
+    // Renders the text into the texture, and restores the screen viewport for nanovg
+    screen->nvg_flush();
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void StatsOverlay::draw(Screen *screen, SessionStats *stats, float x, float y) {
+    auto ctx = screen->nvg_context();
+    uint64_t now = LiGetMillis();
+    
+    if (m_rows_count == 0 || now - m_last_update >= STATS_UPDATE_INTERVAL_MS) {
+        m_last_update = now;
+        
+        nvgSave(ctx);
+        nvgFontFace(ctx, "sans-bold");
+        nvgFontSize(ctx, 20);
+        nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+        update_text(ctx, stats);
+        nvgRestore(ctx);
+        
+        render_text(screen);
+    }
+    
+    float text_height = m_line_height * m_rows_count;
+    float graph_width = std::max(m_text_width, (float)STATS_OVERLAY_FRAME_TIME_COUNT * 2);
+    
+    nvgSave(ctx);
+    
+    // A single translucent background instead of a blurred text shadow pass
+    nvgBeginPath(ctx);
+    nvgRect(ctx, x - 10, y - 10, graph_width + 20, text_height + GRAPH_HEIGHT + 30);
+    nvgFillColor(ctx, Color(0, 0, 0, 160));
+    nvgFill(ctx);
+    
+    // The text as of the last update, one textured quad instead of the glyphs of every row
+    nvgBeginPath(ctx);
+    nvgRect(ctx, x, y, m_texture_width, m_texture_height);
+    nvgFillPaint(ctx, nvgImagePattern(ctx, x, y, m_texture_width, m_texture_height, 0, m_image, 1));
+    nvgFill(ctx);
+    
+    draw_frame_time_graph(ctx, x, y + text_height + 10);
+    
+    nvgRestore(ctx);
+}
+
+void StatsOverlay::draw_frame_time_graph(NVGcontext *ctx, float x, float y) {
+    float step = 2;
+    float width = step * (STATS_OVERLAY_FRAME_TIME_COUNT - 1);
+    
+    // 60 FPS frame time
+    float target_y = y + GRAPH_HEIGHT - (1000.0f / 60 / GRAPH_MAX_FRAME_TIME) * GRAPH_HEIGHT;
+    
+    nvgBeginPath(ctx);
+    nvgMoveTo(ctx, x, target_y);
+    nvgLineTo(ctx, x + width, target_y);
+    nvgStrokeColor(ctx, Color(255, 255, 255, 80));
+    nvgStrokeWidth(ctx, 1);
+    nvgStroke(ctx);
+    
+    nvgBeginPath(ctx);
+    
+    for (int i = 0; i < STATS_OVERLAY_FRAME_TIME_COUNT; i++) {
+        // Oldest value first
+        float frame_time = m_frame_times[(m_frame_time_index + i) % STATS_OVERLAY_FRAME_TIME_COUNT];
+        float value = std::min(frame_time / GRAPH_MAX_FRAME_TIME, 1.0f);
+        float point_x = x + i * step;
+        float point_y = y + GRAPH_HEIGHT - value * GRAPH_HEIGHT;
+        
+        if (i == 0) {
+            nvgMoveTo(ctx, point_x, point_y);
+        } else {
+            nvgLineTo(ctx, point_x, point_y);
+        }
+    }
+    
+    nvgStrokeColor(ctx, Color(0, 255, 0, 255));
+    nvgStrokeWidth(ctx, 1.5f);
+    nvgStroke(ctx);
+}
@@ -0,0 +1,45 @@
+#include "MoonlightSession.hpp"
+#include "nanovg.h"
+#include <glad/glad.h>
+#include <nanogui/nanogui.h>
+#pragma once
+
+#define STATS_OVERLAY_MAX_ROWS 32
+#define STATS_OVERLAY_FRAME_TIME_COUNT 120
+
+class StatsOverlay {
+public:
+    ~StatsOverlay();
+    
+    // Should be called once per a drawn frame, even if the overlay is hidden
+    void frame_tick();
+    
+    void draw(nanogui::Screen *screen, SessionStats *stats, float x, float y);
+    
+private:
+    void update_text(NVGcontext *ctx, SessionStats *stats);
+    int update_audio_text(int offset, AudioRenderStats *stats);
+    int append_text(int offset, const char *format, ...) __attribute__((format(printf, 3, 4)));
+    void render_text(nanogui::Screen *screen);
+    void draw_frame_time_graph(NVGcontext *ctx, float x, float y);
+    
+    char m_text[2048];
+    NVGtextRow m_rows[STATS_OVERLAY_MAX_ROWS];
+    int m_rows_count = 0;
+    float m_line_height = 0;
+    float m_text_width = 0;
+    uint64_t m_last_update = 0;
+    
+    // The text is rendered into a texture on update, and drawn as a single image
+    NVGcontext *m_ctx = NULL;
+    GLuint m_framebuffer = 0;
+    GLuint m_texture = 0;
+    int m_image = 0;
+    int m_texture_width = 0;
+    int m_texture_height = 0;
+    
+    float m_frame_times[STATS_OVERLAY_FRAME_TIME_COUNT] = {0};
+    int m_frame_time_index = 0;
+    int m_frame_time_count = 0;
+    uint64_t m_last_frame_timestamp = 0;
+};
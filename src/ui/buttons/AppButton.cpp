@@ -8,11 +8,12 @@
 
 using namespace nanogui;
 
-AppButton::AppButton(Widget* parent, const std::string &address, AppInfo app, int current_game): Button(parent, "") {
+AppButton::AppButton(Widget* parent, const std::string &address, const AppInfoList &list, const AppInfo &app, int current_game): Button(parent, "") {
     m_address = address;
+    m_names = list.names;
     m_app = app;
     
-    m_label = add<Label>(m_app.name);
+    m_label = add<Label>(std::string(m_app.name));
     
     set_fixed_size(Size(210, 296));
     set_layout(new BoxLayout(Orientation::Vertical, Alignment::Minimum, 10));
@@ -36,7 +37,7 @@ AppButton::AppButton(Widget* parent, const std::string &address, AppInfo app, in
 bool AppButton::gamepad_button_event(int jid, int button, int action) {
     if (action && button == NANOGUI_GAMEPAD_BUTTON_Y) {
         if (auto application = dynamic_cast<Application *>(screen())) {
-            application->push_window<InputSettingsWindow>(m_app.app_id, m_app.name);
+            application->push_window<InputSettingsWindow>(m_app.app_id, std::string(m_app.name));
         }
         return true;
     }
@@ -4,7 +4,7 @@
 
 class AppButton: public nanogui::Button {
 public:
-    AppButton(Widget* parent, const std::string &address, AppInfo app, int current_game);
+    AppButton(Widget* parent, const std::string &address, const AppInfoList &list, const AppInfo &app, int current_game);
     
     bool gamepad_button_event(int jid, int button, int action) override;
     
@@ -13,6 +13,7 @@ public:
     
 private:
     std::string m_address;
+    std::shared_ptr<const std::string> m_names;
     AppInfo m_app;
     nanogui::Label* m_label;
 };
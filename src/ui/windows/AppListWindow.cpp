@@ -62,8 +62,10 @@ void AppListWindow::reload(std::function<void()> callback) {
                     auto button_container = container()->add<Widget>();
                     button_container->set_layout(new AppListLayout());
                     
-                    for (auto &app: result.value()) {
-                        auto button = button_container->add<AppButton>(m_address, app, currentGame);
+                    auto app_list = result.value();
+                    
+                    for (auto &app: app_list) {
+                        auto button = button_container->add<AppButton>(m_address, app_list, app, currentGame);
                         button->set_callback([this, app] {
                             run_game(app.app_id);
                         });
@@ -86,7 +88,8 @@ void AppListWindow::reload(std::function<void()> callback) {
 }
 
 void AppListWindow::run_game(int app_id) {
-    int current_app_id = GameStreamClient::instance().server_data(m_address).currentGame;
+    auto server_data = GameStreamClient::instance().server_data(m_address);
+    int current_app_id = server_data ? server_data->currentGame : 0;
     
     if (current_app_id == 0 || current_app_id == app_id) {
         GamepadMapper::instance().load_gamepad_map(app_id);
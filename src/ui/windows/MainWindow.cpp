@@ -135,13 +135,15 @@ void MainWindow::wake_up_host(const Host &host) {
 void MainWindow::find_host() {
     auto loader = add<LoadingOverlay>("正在查找主机...");
     
-    GameStreamClient::instance().find_host([this, loader](auto result) {
-        loader->dispose();
-        
+    GameStreamClient::instance().find_host([this](auto result) {
         if (result.isSuccess()) {
             Settings::instance().add_host(result.value());
             reload();
-        } else {
+        }
+    }, [this, loader](auto result) {
+        loader->dispose();
+        
+        if (!result.isSuccess()) {
             screen()->add<Alert>("错误", result.error());
         }
     });
@@ -75,7 +75,7 @@ SettingsWindow::SettingsWindow(nanogui::Widget* parent): ContentWindow(parent, "
     }
     
     left_container->add<Label>("视频编码");
-    std::vector<std::string> video_codec = { "H.264", "HEVC (H.265)" };
+    std::vector<std::string> video_codec = { "H.264", "HEVC (H.265)", "HEVC Main10 (10-bit)" };
     auto video_codec_combo_box = left_container->add<ComboBox>(video_codec);
     video_codec_combo_box->set_fixed_width(component_width);
     video_codec_combo_box->popup()->set_fixed_width(component_width);
@@ -83,6 +83,7 @@ SettingsWindow::SettingsWindow(nanogui::Widget* parent): ContentWindow(parent, "
         switch (value) {
             SET_SETTING(0, set_video_codec(H264));
             SET_SETTING(1, set_video_codec(H265));
+            SET_SETTING(2, set_video_codec(H265_MAIN10));
             DEFAULT;
         }
     });
@@ -90,6 +91,7 @@ SettingsWindow::SettingsWindow(nanogui::Widget* parent): ContentWindow(parent, "
     switch (Settings::instance().video_codec()) {
         GET_SETTINGS(video_codec_combo_box, H264, 0);
         GET_SETTINGS(video_codec_combo_box, H265, 1);
+        GET_SETTINGS(video_codec_combo_box, H265_MAIN10, 2);
         DEFAULT;
     }
     
@@ -120,6 +122,18 @@ SettingsWindow::SettingsWindow(nanogui::Widget* parent): ContentWindow(parent, "
         Settings::instance().set_click_by_tap(value);
     });
     
+    auto local_cursor = left_container->add<CheckBox>("串流时显示本地鼠标指针");
+    local_cursor->set_checked(Settings::instance().local_cursor());
+    local_cursor->set_callback([](auto value) {
+        Settings::instance().set_local_cursor(value);
+    });
+    
+    auto relative_mouse = left_container->add<CheckBox>("鼠标使用相对移动 (游戏捕获光标)");
+    relative_mouse->set_checked(Settings::instance().relative_mouse());
+    relative_mouse->set_callback([](auto value) {
+        Settings::instance().set_relative_mouse(value);
+    });
+    
     auto right_container = container()->add<Widget>();
     right_container->set_layout(new GroupLayout(30, 10, 30, 10));
     right_container->set_fixed_width(container_width + 90);
@@ -147,6 +161,27 @@ SettingsWindow::SettingsWindow(nanogui::Widget* parent): ContentWindow(parent, "
         DEFAULT;
     }
     
+    right_container->add<Label>("音频声道");
+    std::vector<std::string> audio_channels = { "立体声", "5.1 环绕声", "7.1 环绕声" };
+    auto audio_channels_combo_box = right_container->add<ComboBox>(audio_channels);
+    audio_channels_combo_box->set_fixed_width(component_width);
+    audio_channels_combo_box->popup()->set_fixed_width(component_width);
+    audio_channels_combo_box->set_callback([](auto value) {
+        switch (value) {
+            SET_SETTING(0, set_audio_channels(STEREO));
+            SET_SETTING(1, set_audio_channels(SURROUND_51));
+            SET_SETTING(2, set_audio_channels(SURROUND_71));
+            DEFAULT;
+        }
+    });
+    
+    switch (Settings::instance().audio_channels()) {
+        GET_SETTINGS(audio_channels_combo_box, STEREO, 0);
+        GET_SETTINGS(audio_channels_combo_box, SURROUND_51, 1);
+        GET_SETTINGS(audio_channels_combo_box, SURROUND_71, 2);
+        DEFAULT;
+    }
+    
     right_container->add<Label>("串流设置");
     auto sops = right_container->add<CheckBox>("使用优化的游戏设置");
     sops->set_checked(Settings::instance().sops());
@@ -160,6 +195,12 @@ SettingsWindow::SettingsWindow(nanogui::Widget* parent): ContentWindow(parent, "
         Settings::instance().set_play_audio(value);
     });
     
+    auto av_sync = right_container->add<CheckBox>("音视频同步");
+    av_sync->set_checked(Settings::instance().av_sync());
+    av_sync->set_callback([](auto value) {
+        Settings::instance().set_av_sync(value);
+    });
+    
     right_container->add<Label>("调试");
     auto write_log = right_container->add<CheckBox>("写日志");
     write_log->set_checked(Settings::instance().write_log());
@@ -167,6 +208,20 @@ SettingsWindow::SettingsWindow(nanogui::Widget* parent): ContentWindow(parent, "
         Settings::instance().set_write_log(value);
     });
     
+    auto use_pbo = right_container->add<CheckBox>("使用 PBO 上传视频帧");
+    use_pbo->set_checked(Settings::instance().use_pbo());
+    use_pbo->set_callback([](auto value) {
+        Settings::instance().set_use_pbo(value);
+    });
+    
+    #ifndef __SWITCH__
+    auto record_audio = right_container->add<CheckBox>("录制音频到 audio.wav");
+    record_audio->set_checked(Settings::instance().record_audio());
+    record_audio->set_callback([](auto value) {
+        Settings::instance().set_record_audio(value);
+    });
+    #endif
+    
     auto log_button = right_container->add<Button>("显示日志");
     log_button->set_fixed_width(component_width);
     log_button->set_callback([this] {
@@ -5,10 +5,12 @@
 #include "MouseController.hpp"
 #include "FFmpegVideoDecoder.hpp"
 #include "GLVideoRenderer.hpp"
+#include "Settings.hpp"
 #ifdef __SWITCH__
 #include "AudrenAudioRenderer.hpp"
 #endif
 #include "DebugFileRecorderAudioRenderer.hpp"
+#include "NullAudioRenderer.hpp"
 #include "nanovg.h"
 #include <algorithm>
 #include <memory>
@@ -16,18 +18,24 @@
 using namespace nanogui;
 
 StreamWindow::StreamWindow(Widget *parent, const std::string &address, int app_id): Widget(parent) {
-    MouseController::instance().set_draw_cursor_for_hid_mouse(false);
+    // The local cursor is drawn at input rate, without a round trip to the host
+    MouseController::instance().set_draw_cursor_for_hid_mouse(Settings::instance().local_cursor());
+    MouseController::instance().set_stream_mouse_is_relative(Settings::instance().relative_mouse());
     
     m_size = parent->size();
     m_session = new MoonlightSession(address, app_id);
     
     m_session->set_video_decoder(new FFmpegVideoDecoder());
-    m_session->set_video_renderer(new GLVideoRenderer());
+    m_session->set_video_renderer(new GLVideoRenderer(Settings::instance().use_pbo()));
     
     #ifdef __SWITCH__
     m_session->set_audio_renderer(new AudrenAudioRenderer());
     #else
-    m_session->set_audio_renderer(new DebugFileRecorderAudioRenderer(false));
+    if (Settings::instance().record_audio()) {
+        m_session->set_audio_renderer(new DebugFileRecorderAudioRenderer(true, Settings::instance().audio_record_path()));
+    } else {
+        m_session->set_audio_renderer(new NullAudioRenderer());
+    }
     #endif
     
     m_loader = add<LoadingOverlay>("正在启动...");
@@ -54,6 +62,7 @@ StreamWindow::StreamWindow(Widget *parent, const std::string &address, int app_i
 
 StreamWindow::~StreamWindow() {
     MouseController::instance().set_draw_cursor_for_hid_mouse(true);
+    MouseController::instance().set_stream_mouse_is_relative(false);
     delete m_session;
 }
 
@@ -64,7 +73,7 @@ void StreamWindow::draw(NVGcontext *ctx) {
     
     nvgSave(ctx);
     
-    m_session->draw();
+    m_session->draw(screen()->framebuffer_size().x(), screen()->framebuffer_size().y());
     
     nvgRestore(ctx);
     
@@ -87,45 +96,10 @@ void StreamWindow::draw(NVGcontext *ctx) {
         nvgText(ctx, 50, height() - 28, "连接不稳定...", NULL);
     }
     
+    m_stats_overlay.frame_tick();
+    
     if (m_draw_stats) {
-        static char output[1024];
-        
-        int offset = 0;
-        
-        auto stats = m_session->session_stats();
-        
-        offset += sprintf(&output[offset],
-                          "估计主机帧率: %.2f FPS\n"
-                          "网络输入帧率: %.2f FPS\n"
-                          "解码器帧率: %.2f FPS\n"
-                          "渲染帧率: %.2f FPS\n",
-                          stats->video_decode_stats.total_fps,
-                          stats->video_decode_stats.received_fps,
-                          stats->video_decode_stats.decoded_fps,
-                          stats->video_render_stats.rendered_fps);
-        
-        offset += sprintf(&output[offset],
-                          "网络连接掉帧: %.2f%% (Total: %u)\n"
-                          "平均接收时间: %.2f 毫秒\n"
-                          "平均解码时间: %.2f 毫秒\n"
-                          "平均渲染时间: %.2f 毫秒\n",
-                          (float)stats->video_decode_stats.network_dropped_frames / stats->video_decode_stats.total_frames * 100,
-                          stats->video_decode_stats.network_dropped_frames,
-                          (float)stats->video_decode_stats.total_reassembly_time / stats->video_decode_stats.received_frames,
-                          (float)stats->video_decode_stats.total_decode_time / stats->video_decode_stats.decoded_frames,
-                          (float)stats->video_render_stats.total_render_time / stats->video_render_stats.rendered_frames);
-        
-        nvgFontFace(ctx, "sans-bold");
-        nvgFontSize(ctx, 20);
-        nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_BOTTOM);
-        
-        nvgFontBlur(ctx, 1);
-        nvgFillColor(ctx, Color(0, 0, 0, 255));
-        nvgTextBox(ctx, 20, 30, width(), output, NULL);
-        
-        nvgFontBlur(ctx, 0);
-        nvgFillColor(ctx, Color(0, 255, 0, 255));
-        nvgTextBox(ctx, 20, 30, width(), output, NULL);
+        m_stats_overlay.draw(screen(), m_session->session_stats(), 20, 20);
     }
     
     // TODO: Get out of here...
@@ -2,6 +2,7 @@
 #include "GameStreamClient.hpp"
 #include "LoadingOverlay.hpp"
 #include "MoonlightSession.hpp"
+#include "StatsOverlay.hpp"
 #pragma once
 
 class StreamWindow: public nanogui::Widget {
@@ -19,6 +20,7 @@ public:
 private:
     MoonlightSession* m_session;
     LoadingOverlay* m_loader;
+    StatsOverlay m_stats_overlay;
     bool m_draw_stats = false;
     bool m_should_show_stats = false;
     bool m_is_terminated = false;
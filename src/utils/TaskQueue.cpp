@@ -0,0 +1,121 @@
+#include "TaskQueue.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+
+static const char* priority_name(TaskPriority priority) {
+    switch (priority) {
+        case TaskPriority::BoxArt:
+            return "boxart";
+        case TaskPriority::AppList:
+            return "applist";
+        case TaskPriority::ServerInfo:
+            return "serverinfo";
+        case TaskPriority::Launch:
+            return "launch";
+        default:
+            return "unknown";
+    }
+}
+
+void TaskQueue::start(int worker_count) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    
+    if (m_is_running) {
+        return;
+    }
+    
+    m_is_running = true;
+    m_worker_count = std::min(std::max(worker_count, 1), TASK_QUEUE_MAX_WORKERS);
+    
+    for (int i = 0; i < m_worker_count; i++) {
+        #ifdef __SWITCH__
+        threadCreate(&m_workers[i], worker_entry, this, NULL, 0x10000, 0x2C, -2);
+        threadStart(&m_workers[i]);
+        #else
+        m_workers[i] = std::thread(worker_entry, this);
+        #endif
+    }
+}
+
+void TaskQueue::stop() {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        
+        if (!m_is_running) {
+            return;
+        }
+        
+        m_is_running = false;
+        m_tasks = {};
+    }
+    m_condition.notify_all();
+    
+    for (int i = 0; i < m_worker_count; i++) {
+        #ifdef __SWITCH__
+        threadWaitForExit(&m_workers[i]);
+        threadClose(&m_workers[i]);
+        #else
+        m_workers[i].join();
+        #endif
+    }
+    m_worker_count = 0;
+}
+
+void TaskQueue::push(TaskPriority priority, const char* name, const std::function<void()> &function) {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_tasks.push({ priority, m_next_sequence++, std::chrono::steady_clock::now(), name, function });
+    }
+    m_condition.notify_one();
+}
+
+void TaskQueue::worker_entry(void* context) {
+    if (auto queue = static_cast<TaskQueue *>(context)) {
+        queue->worker_loop();
+    }
+}
+
+void TaskQueue::worker_loop() {
+    while (true) {
+        Task task; {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return !m_is_running || !m_tasks.empty(); });
+            
+            if (!m_is_running) {
+                return;
+            }
+            
+            task = m_tasks.top();
+            m_tasks.pop();
+        }
+        
+        auto start_time = std::chrono::steady_clock::now();
+        task.function();
+        auto end_time = std::chrono::steady_clock::now();
+        
+        uint64_t wait_us = std::chrono::duration_cast<std::chrono::microseconds>(start_time - task.push_time).count();
+        uint64_t run_us = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+        record(task, wait_us, run_us);
+    }
+}
+
+void TaskQueue::record(const Task &task, uint64_t wait_us, uint64_t run_us) {
+    TaskMetrics metrics; {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        
+        TaskMetrics &current = m_metrics[(int)task.priority];
+        current.tasks++;
+        current.total_wait_us += wait_us;
+        current.max_wait_us = std::max(current.max_wait_us, wait_us);
+        current.total_run_us += run_us;
+        current.max_run_us = std::max(current.max_run_us, run_us);
+        metrics = current;
+    }
+    
+    Logger::info("TaskQueue", "%s: wait %.1f ms, run %.1f ms (%s avg wait %.1f ms, max %.1f ms, avg run %.1f ms, max %.1f ms, %u tasks)",
+                 task.name, wait_us / 1000.0f, run_us / 1000.0f,
+                 priority_name(task.priority),
+                 metrics.total_wait_us / 1000.0f / metrics.tasks, metrics.max_wait_us / 1000.0f,
+                 metrics.total_run_us / 1000.0f / metrics.tasks, metrics.max_run_us / 1000.0f,
+                 metrics.tasks);
+}
@@ -0,0 +1,79 @@
+#include "Singleton.hpp"
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+#ifdef __SWITCH__
+#include <switch.h>
+#else
+#include <thread>
+#endif
+#pragma once
+
+#define TASK_QUEUE_MAX_WORKERS 4
+
+// Higher runs first, tasks with the same priority run in the order of push()
+enum class TaskPriority: int {
+    BoxArt = 0,
+    AppList,
+    ServerInfo,
+    Launch,
+    Count
+};
+
+class TaskQueue: public Singleton<TaskQueue> {
+public:
+    void start(int worker_count);
+    
+    // Waits for running tasks, pending tasks are dropped
+    void stop();
+    
+    void push(TaskPriority priority, const char* name, const std::function<void()> &function);
+    
+private:
+    struct Task {
+        TaskPriority priority;
+        uint64_t sequence;
+        std::chrono::steady_clock::time_point push_time;
+        const char* name;
+        std::function<void()> function;
+    };
+    
+    struct TaskOrder {
+        bool operator()(const Task &a, const Task &b) const {
+            if (a.priority != b.priority) {
+                return a.priority < b.priority;
+            }
+            return a.sequence > b.sequence;
+        }
+    };
+    
+    struct TaskMetrics {
+        uint32_t tasks;
+        uint64_t total_wait_us;
+        uint64_t max_wait_us;
+        uint64_t total_run_us;
+        uint64_t max_run_us;
+    };
+    
+    static void worker_entry(void* context);
+    void worker_loop();
+    void record(const Task &task, uint64_t wait_us, uint64_t run_us);
+    
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::priority_queue<Task, std::vector<Task>, TaskOrder> m_tasks;
+    uint64_t m_next_sequence = 0;
+    bool m_is_running = false;
+    TaskMetrics m_metrics[(int)TaskPriority::Count] = {};
+    
+    int m_worker_count = 0;
+    #ifdef __SWITCH__
+    Thread m_workers[TASK_QUEUE_MAX_WORKERS];
+    #else
+    std::thread m_workers[TASK_QUEUE_MAX_WORKERS];
+    #endif
+};
@@ -0,0 +1,576 @@
+#include "GameStreamStandIn.hpp"
+#include "CryptoManager.hpp"
+#include "client.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#define SERVER_MAJOR_VERSION "7"
+#define LISTEN_BACKLOG 16
+
+static std::string field(const std::string &name, const std::string &value) {
+    return "<" + name + ">" + value + "</" + name + ">\n";
+}
+
+static std::string document(const std::string &fields, int status_code = 200, const std::string &status_message = "OK") {
+    return "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<root protocol_version=\"0.1\" status_code=\"" +
+        std::to_string(status_code) + "\" status_message=\"" + status_message + "\">\n" + fields + "</root>\n";
+}
+
+static std::string hex_string(const Data &data) {
+    Data hex = data.hex();
+    return std::string((char *)hex.bytes(), hex.size());
+}
+
+static Data bytes_of_hex(const std::string &hex) {
+    return Data((char *)hex.c_str(), hex.size()).hex_to_bytes();
+}
+
+static bool is_equal(const Data &a, const Data &b) {
+    return a.size() == b.size() && (a.size() == 0 || memcmp(a.bytes(), b.bytes(), a.size()) == 0);
+}
+
+static std::string pem_of(X509 *cert) {
+    BIO *bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_X509(bio, cert);
+    
+    BUF_MEM *mem;
+    BIO_get_mem_ptr(bio, &mem);
+    std::string pem(mem->data, mem->length);
+    BIO_free(bio);
+    return pem;
+}
+
+// Same certificate, same PEM, however the client wrote it
+static std::string normalized_pem(const Data &pem) {
+    BIO *bio = BIO_new_mem_buf(pem.bytes(), (int)pem.size());
+    X509 *cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+    
+    if (!cert) {
+        return "";
+    }
+    
+    std::string result = pem_of(cert);
+    X509_free(cert);
+    return result;
+}
+
+GameStreamStandIn::GameStreamStandIn(const StandInConfig &config): m_config(config) {
+    // A client can go away while a response is written
+    signal(SIGPIPE, SIG_IGN);
+    
+    if (!create_certificate()) {
+        return;
+    }
+    
+    m_http_socket = listen_on(GAMESTREAM_HTTP_PORT);
+    m_https_socket = listen_on(GAMESTREAM_HTTPS_PORT);
+    
+    if (m_http_socket < 0 || m_https_socket < 0) {
+        fprintf(stderr, "Stand-in can't listen on %i and %i: %s\n", GAMESTREAM_HTTP_PORT, GAMESTREAM_HTTPS_PORT, strerror(errno));
+        return;
+    }
+    
+    m_is_running = true;
+    m_accept_threads.emplace_back([this] { accept_loop(m_http_socket, false); });
+    m_accept_threads.emplace_back([this] { accept_loop(m_https_socket, true); });
+}
+
+GameStreamStandIn::~GameStreamStandIn() {
+    m_is_running = false;
+    
+    for (auto &thread: m_accept_threads) {
+        thread.join();
+    }
+    
+    // Unblocks the reads of kept alive connections
+    {
+        std::lock_guard<std::mutex> guard(m_connections_mutex);
+        
+        for (int socket: m_connection_sockets) {
+            shutdown(socket, SHUT_RDWR);
+        }
+    }
+    
+    for (auto &thread: m_connection_threads) {
+        thread.join();
+    }
+    
+    if (m_http_socket >= 0) {
+        close(m_http_socket);
+    }
+    
+    if (m_https_socket >= 0) {
+        close(m_https_socket);
+    }
+    
+    if (m_ssl_context) {
+        SSL_CTX_free(m_ssl_context);
+    }
+}
+
+void GameStreamStandIn::set_config(const StandInConfig &config) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_config = config;
+}
+
+bool GameStreamStandIn::is_paired() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return !m_paired_cert.empty();
+}
+
+int GameStreamStandIn::current_game() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_current_game;
+}
+
+int GameStreamStandIn::requests(const std::string &endpoint) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_requests[endpoint];
+}
+
+int GameStreamStandIn::tls_handshakes() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_tls_handshakes;
+}
+
+int GameStreamStandIn::resumed_tls_handshakes() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_resumed_tls_handshakes;
+}
+
+std::string GameStreamStandIn::app_title(int index) {
+    return "Game " + std::to_string(index + 1);
+}
+
+int GameStreamStandIn::app_id(int index) {
+    return 1000 + index;
+}
+
+bool GameStreamStandIn::create_certificate() {
+    EVP_PKEY *key = NULL;
+    EVP_PKEY_CTX *key_context = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    
+    if (!key_context || EVP_PKEY_keygen_init(key_context) <= 0 || EVP_PKEY_CTX_set_rsa_keygen_bits(key_context, 2048) <= 0 || EVP_PKEY_keygen(key_context, &key) <= 0) {
+        fprintf(stderr, "Stand-in key generation failed\n");
+        EVP_PKEY_CTX_free(key_context);
+        return false;
+    }
+    
+    EVP_PKEY_CTX_free(key_context);
+    
+    X509 *cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 60 * 60 * 24);
+    X509_set_pubkey(cert, key);
+    
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"NVIDIA GameStream Server", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+    
+    std::string cert_pem = pem_of(cert);
+    m_server_cert = Data((char *)cert_pem.c_str(), cert_pem.size());
+    
+    BIO *bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_PrivateKey(bio, key, NULL, NULL, 0, NULL, NULL);
+    BUF_MEM *mem;
+    BIO_get_mem_ptr(bio, &mem);
+    m_server_key = Data(mem->data, mem->length);
+    BIO_free(bio);
+    
+    // Any client certificate is accepted, the requests check it against the paired one
+    m_ssl_context = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_use_certificate(m_ssl_context, cert);
+    SSL_CTX_use_PrivateKey(m_ssl_context, key);
+    SSL_CTX_set_verify(m_ssl_context, SSL_VERIFY_PEER, [](int preverify_ok, X509_STORE_CTX *store) { return 1; });
+    SSL_CTX_set_session_id_context(m_ssl_context, (const unsigned char *)"standin", 7);
+    
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return true;
+}
+
+int GameStreamStandIn::listen_on(unsigned short port) {
+    int listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    
+    int reuse = 1;
+    setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    
+    if (bind(listen_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_socket, LISTEN_BACKLOG) < 0) {
+        close(listen_socket);
+        return -1;
+    }
+    return listen_socket;
+}
+
+void GameStreamStandIn::accept_loop(int listen_socket, bool is_https) {
+    while (m_is_running) {
+        struct pollfd fd = { listen_socket, POLLIN, 0 };
+        if (poll(&fd, 1, 20) <= 0) {
+            continue;
+        }
+        
+        int socket = accept(listen_socket, NULL, NULL);
+        if (socket < 0) {
+            continue;
+        }
+        
+        std::lock_guard<std::mutex> guard(m_connections_mutex);
+        m_connection_sockets.push_back(socket);
+        m_connection_threads.emplace_back([this, socket, is_https] { serve_connection(socket, is_https); });
+    }
+}
+
+void GameStreamStandIn::serve_connection(int socket, bool is_https) {
+    SSL *ssl = NULL;
+    std::string client_cert;
+    
+    if (is_https) {
+        ssl = SSL_new(m_ssl_context);
+        SSL_set_fd(ssl, socket);
+        
+        if (SSL_accept(ssl) > 0) {
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_tls_handshakes++;
+                
+                if (SSL_session_reused(ssl)) {
+                    m_resumed_tls_handshakes++;
+                }
+            }
+            
+            if (X509 *cert = SSL_get_peer_certificate(ssl)) {
+                client_cert = pem_of(cert);
+                X509_free(cert);
+            }
+        } else {
+            SSL_free(ssl);
+            ssl = NULL;
+        }
+    }
+    
+    auto read_some = [&](char *buffer, int size) {
+        return ssl ? SSL_read(ssl, buffer, size) : (int)recv(socket, buffer, size, 0);
+    };
+    
+    auto write_all = [&](const std::string &data) {
+        size_t offset = 0;
+        
+        while (offset < data.size()) {
+            int size = (int)std::min(data.size() - offset, (size_t)16384);
+            int written = ssl ? SSL_write(ssl, data.data() + offset, size) : (int)send(socket, data.data() + offset, size, MSG_NOSIGNAL);
+            
+            if (written <= 0) {
+                return false;
+            }
+            offset += written;
+        }
+        return true;
+    };
+    
+    std::string buffer;
+    
+    // GET requests one after another on a kept alive connection
+    while (m_is_running && (ssl || !is_https)) {
+        size_t end;
+        
+        while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+            char chunk[4096];
+            int size = read_some(chunk, sizeof(chunk));
+            
+            if (size <= 0) {
+                break;
+            }
+            buffer.append(chunk, size);
+        }
+        
+        if (end == std::string::npos) {
+            break;
+        }
+        
+        // GET /endpoint?name=value&name=value HTTP/1.1
+        std::string line = buffer.substr(0, buffer.find("\r\n"));
+        buffer.erase(0, end + 4);
+        
+        size_t target_start = line.find(' ') + 1;
+        std::string target = line.substr(target_start, line.find(' ', target_start) - target_start);
+        
+        Request request;
+        request.is_https = is_https;
+        request.client_cert = client_cert;
+        
+        size_t query_start = target.find('?');
+        request.endpoint = target.substr(1, query_start == std::string::npos ? std::string::npos : query_start - 1);
+        
+        if (query_start != std::string::npos) {
+            std::string query = target.substr(query_start + 1);
+            size_t start = 0;
+            
+            while (start < query.size()) {
+                size_t pair_end = query.find('&', start);
+                if (pair_end == std::string::npos) {
+                    pair_end = query.size();
+                }
+                
+                std::string pair = query.substr(start, pair_end - start);
+                size_t equals = pair.find('=');
+                request.query[pair.substr(0, equals)] = equals == std::string::npos ? "" : pair.substr(equals + 1);
+                start = pair_end + 1;
+            }
+        }
+        
+        Response response = respond(request);
+        
+        if (response.drop_connection) {
+            break;
+        }
+        
+        std::string status_line = response.http_status == 200 ? "200 OK" : std::to_string(response.http_status) + " Error";
+        std::string head = "HTTP/1.1 " + status_line + "\r\nContent-Type: " + response.content_type +
+            "\r\nContent-Length: " + std::to_string(response.body.size()) + "\r\nConnection: keep-alive\r\n\r\n";
+        
+        if (!write_all(head + response.body)) {
+            break;
+        }
+    }
+    
+    if (ssl) {
+        SSL_free(ssl);
+    }
+    
+    std::lock_guard<std::mutex> guard(m_connections_mutex);
+    m_connection_sockets.erase(std::find(m_connection_sockets.begin(), m_connection_sockets.end(), socket));
+    close(socket);
+}
+
+GameStreamStandIn::Response GameStreamStandIn::respond(const Request &request) {
+    StandInFailure failure = StandInFailure::None;
+    int latency_ms;
+    
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_requests[request.endpoint]++;
+        latency_ms = m_config.latency_ms;
+        
+        if (m_config.failures.count(request.endpoint)) {
+            failure = m_config.failures[request.endpoint];
+        }
+    }
+    
+    std::this_thread::sleep_for(std::chrono::milliseconds(latency_ms));
+    
+    Response response;
+    
+    switch (failure) {
+        case StandInFailure::HttpError:
+            response.http_status = 500;
+            return response;
+        case StandInFailure::DropConnection:
+            response.drop_connection = true;
+            return response;
+        case StandInFailure::MalformedXml:
+            response.body = document(field("hostname", "STANDIN-PC")).substr(0, 120);
+            return response;
+        case StandInFailure::StatusCode:
+            response.body = document("", 503, "Service Unavailable");
+            return response;
+        case StandInFailure::None:
+            break;
+    }
+    
+    // The handlers run under the lock
+    std::lock_guard<std::mutex> guard(m_mutex);
+    
+    // Like GFE, HTTPS is only for the paired client
+    if (request.is_https && (m_paired_cert.empty() || request.client_cert != m_paired_cert)) {
+        response.body = document("", 401, "The client is not authorized. Certificate verification failed.");
+        return response;
+    }
+    
+    if (request.endpoint == "serverinfo") {
+        return serverinfo(request);
+    } else if (request.endpoint == "applist") {
+        return applist();
+    } else if (request.endpoint == "appasset") {
+        return appasset(request);
+    } else if (request.endpoint == "launch") {
+        return launch(request);
+    } else if (request.endpoint == "resume") {
+        return resume();
+    } else if (request.endpoint == "cancel") {
+        return cancel();
+    } else if (request.endpoint == "pair") {
+        return pair(request);
+    } else if (request.endpoint == "unpair") {
+        return unpair();
+    }
+    
+    response.http_status = 404;
+    return response;
+}
+
+GameStreamStandIn::Response GameStreamStandIn::serverinfo(const Request &request) {
+    std::string modes;
+    const int display_modes[][3] = { { 3840, 2160, 60 }, { 1920, 1080, 60 }, { 1280, 720, 60 } };
+    
+    for (auto &mode: display_modes) {
+        modes += "<DisplayMode>\n" + field("Width", std::to_string(mode[0])) + field("Height", std::to_string(mode[1])) +
+            field("RefreshRate", std::to_string(mode[2])) + "</DisplayMode>\n";
+    }
+    
+    Response response;
+    response.body = document(
+        field("hostname", "STANDIN-PC") +
+        field("appversion", SERVER_MAJOR_VERSION ".1.431.-1") +
+        field("GfeVersion", "3.23.0.74") +
+        field("uniqueid", "0123456789ABCDEF") +
+        field("HttpsPort", std::to_string(GAMESTREAM_HTTPS_PORT)) +
+        field("ExternalPort", std::to_string(GAMESTREAM_HTTP_PORT)) +
+        field("mac", "00:11:22:33:44:55") +
+        field("ServerCodecModeSupport", "259") +
+        "<SupportedDisplayMode>\n" + modes + "</SupportedDisplayMode>\n" +
+        // Over HTTP the host doesn't know the client, it's never paired there
+        field("PairStatus", request.is_https ? "1" : "0") +
+        field("currentgame", std::to_string(m_current_game)) +
+        field("state", m_current_game != 0 ? "SUNSHINE_SERVER_BUSY" : "SUNSHINE_SERVER_FREE") +
+        field("gputype", "NVIDIA GeForce RTX 3070") +
+        field("GsVersion", "6.2.0.0")
+    );
+    return response;
+}
+
+GameStreamStandIn::Response GameStreamStandIn::applist() {
+    std::string apps;
+    
+    for (int i = 0; i < m_config.app_count; i++) {
+        apps += "<App>\n" + field("IsHdrSupported", "0") + field("AppTitle", app_title(i)) + field("ID", std::to_string(app_id(i))) + "</App>\n";
+    }
+    
+    Response response;
+    response.body = document(apps);
+    return response;
+}
+
+GameStreamStandIn::Response GameStreamStandIn::appasset(const Request &request) {
+    Response response;
+    int id = atoi(request.query.count("appid") ? request.query.at("appid").c_str() : "0");
+    
+    if (id < app_id(0) || id >= app_id(m_config.app_count)) {
+        response.http_status = 404;
+        return response;
+    }
+    
+    // A PNG signature, then filler of the configured size
+    response.content_type = "image/png";
+    response.body = std::string("\x89PNG\r\n\x1a\n", 8);
+    response.body.resize(std::max(m_config.boxart_size, response.body.size()), (char)id);
+    return response;
+}
+
+GameStreamStandIn::Response GameStreamStandIn::launch(const Request &request) {
+    Response response;
+    
+    if (m_current_game != 0) {
+        response.body = document("", 400, "An app is already running");
+        return response;
+    }
+    
+    m_current_game = atoi(request.query.count("appid") ? request.query.at("appid").c_str() : "0");
+    response.body = document(field("sessionUrl0", "rtsp://127.0.0.1:48010") + field("gamesession", "1"));
+    return response;
+}
+
+GameStreamStandIn::Response GameStreamStandIn::resume() {
+    Response response;
+    response.body = document(field("resume", m_current_game != 0 ? "1" : "0"));
+    return response;
+}
+
+GameStreamStandIn::Response GameStreamStandIn::cancel() {
+    m_current_game = 0;
+    
+    Response response;
+    response.body = document(field("cancel", "1"));
+    return response;
+}
+
+// The host side of the four stage exchange in gs_pair, with the SHA256 of generation 7
+GameStreamStandIn::Response GameStreamStandIn::pair(const Request &request) {
+    auto value = [&request](const std::string &name) {
+        return request.query.count(name) ? request.query.at(name) : std::string();
+    };
+    
+    Response response;
+    
+    if (value("phrase") == "getservercert") {
+        Data salt = bytes_of_hex(value("salt"));
+        Data pin = Data((char *)m_config.pin.c_str(), m_config.pin.size());
+        
+        m_pairing = PairingState();
+        m_pairing.client_cert = bytes_of_hex(value("clientcert"));
+        m_pairing.aes_key = CryptoManager::create_AES_key_from_salt_SHA256(salt.append(pin));
+        
+        response.body = document(field("paired", "1") + field("plaincert", hex_string(m_server_cert)));
+    } else if (!value("clientchallenge").empty()) {
+        Data client_challenge = CryptoManager::aes_decrypt(bytes_of_hex(value("clientchallenge")), m_pairing.aes_key);
+        m_pairing.server_challenge = Data::random_bytes(16);
+        m_pairing.server_secret = Data::random_bytes(16);
+        
+        Data hash = CryptoManager::SHA256_hash_data(client_challenge.append(CryptoManager::signature(m_server_cert)).append(m_pairing.server_secret));
+        Data challenge_response = CryptoManager::aes_encrypt(hash.append(m_pairing.server_challenge), m_pairing.aes_key);
+        
+        response.body = document(field("paired", "1") + field("challengeresponse", hex_string(challenge_response)));
+    } else if (!value("serverchallengeresp").empty()) {
+        m_pairing.client_hash = CryptoManager::aes_decrypt(bytes_of_hex(value("serverchallengeresp")), m_pairing.aes_key).subdata(0, 32);
+        
+        Data pairing_secret = m_pairing.server_secret.append(CryptoManager::sign_data(m_pairing.server_secret, m_server_key));
+        response.body = document(field("paired", "1") + field("pairingsecret", hex_string(pairing_secret)));
+    } else if (!value("clientpairingsecret").empty()) {
+        Data client_pairing_secret = bytes_of_hex(value("clientpairingsecret"));
+        Data client_secret = client_pairing_secret.subdata(0, 16);
+        Data client_signature = client_pairing_secret.subdata(16, client_pairing_secret.size() - 16);
+        
+        // A wrong PIN gives another AES key, so the decrypted hash doesn't match
+        Data expected_hash = CryptoManager::SHA256_hash_data(m_pairing.server_challenge.append(CryptoManager::signature(m_pairing.client_cert)).append(client_secret));
+        bool is_paired = is_equal(expected_hash, m_pairing.client_hash) &&
+            CryptoManager::verify_signature(client_secret, client_signature, m_pairing.client_cert);
+        
+        if (is_paired) {
+            m_paired_cert = normalized_pem(m_pairing.client_cert);
+        }
+        
+        response.body = document(field("paired", is_paired ? "1" : "0"));
+    } else if (value("phrase") == "pairchallenge") {
+        response.body = document(field("paired", "1"));
+    } else {
+        response.body = document("", 400, "Unknown pairing stage");
+    }
+    return response;
+}
+
+GameStreamStandIn::Response GameStreamStandIn::unpair() {
+    m_paired_cert.clear();
+    
+    Response response;
+    response.body = document("");
+    return response;
+}
@@ -0,0 +1,123 @@
+#include "Data.hpp"
+#include <openssl/ssl.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#pragma once
+
+// How an endpoint answers instead of the normal response
+enum class StandInFailure {
+    None,
+    // 500 Internal Server Error, curl fails it
+    HttpError,
+    // The connection is closed without a response
+    DropConnection,
+    // The document is cut off in the middle
+    MalformedXml,
+    // A valid document with status_code 503
+    StatusCode
+};
+
+struct StandInConfig {
+    // Before every response
+    int latency_ms = 0;
+    int app_count = 3;
+    size_t boxart_size = 32 * 1024;
+    // Entered on the host while pairing
+    std::string pin = "1234";
+    // By the endpoint, like "applist" or "serverinfo", for HTTP and HTTPS both
+    std::map<std::string, StandInFailure> failures;
+};
+
+// A GameStream host on loopback, on GAMESTREAM_HTTP_PORT and GAMESTREAM_HTTPS_PORT.
+// Serves serverinfo, applist, appasset, launch, resume, cancel, pair and unpair like
+// GFE 3.x, with a self-signed certificate. HTTPS answers only the paired client.
+class GameStreamStandIn {
+public:
+    GameStreamStandIn(const StandInConfig &config = StandInConfig());
+    ~GameStreamStandIn();
+    
+    // False if a port can't be bound
+    bool is_running() const {
+        return m_is_running;
+    }
+    
+    void set_config(const StandInConfig &config);
+    
+    bool is_paired();
+    int current_game();
+    
+    // Served requests to the endpoint, including the failed ones
+    int requests(const std::string &endpoint);
+    
+    // Completed TLS handshakes, one per HTTPS connection, and the resumed ones of them
+    int tls_handshakes();
+    int resumed_tls_handshakes();
+    
+    static std::string app_title(int index);
+    static int app_id(int index);
+    
+private:
+    struct Request {
+        std::string endpoint;
+        std::map<std::string, std::string> query;
+        bool is_https;
+        // PEM of the TLS client certificate
+        std::string client_cert;
+    };
+    
+    struct Response {
+        int http_status = 200;
+        std::string content_type = "text/xml";
+        std::string body;
+        bool drop_connection = false;
+    };
+    
+    struct PairingState {
+        Data client_cert;
+        Data aes_key;
+        Data server_challenge;
+        Data server_secret;
+        Data client_hash;
+    };
+    
+    bool create_certificate();
+    int listen_on(unsigned short port);
+    void accept_loop(int listen_socket, bool is_https);
+    void serve_connection(int socket, bool is_https);
+    
+    Response respond(const Request &request);
+    Response serverinfo(const Request &request);
+    Response applist();
+    Response appasset(const Request &request);
+    Response launch(const Request &request);
+    Response resume();
+    Response cancel();
+    Response pair(const Request &request);
+    Response unpair();
+    
+    std::mutex m_mutex;
+    StandInConfig m_config;
+    std::map<std::string, int> m_requests;
+    int m_tls_handshakes = 0;
+    int m_resumed_tls_handshakes = 0;
+    PairingState m_pairing;
+    std::string m_paired_cert;
+    int m_current_game = 0;
+    
+    Data m_server_cert;
+    Data m_server_key;
+    SSL_CTX *m_ssl_context = nullptr;
+    
+    std::atomic<bool> m_is_running = {false};
+    int m_http_socket = -1;
+    int m_https_socket = -1;
+    std::vector<std::thread> m_accept_threads;
+    
+    std::mutex m_connections_mutex;
+    std::vector<int> m_connection_sockets;
+    std::vector<std::thread> m_connection_threads;
+};
@@ -0,0 +1,27 @@
+#include <stdio.h>
+#pragma once
+
+// A failed CHECK is reported and counted, the test goes on with the next one
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%i: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            test_failures()++; \
+        } \
+    } while (0)
+
+inline int& test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+// Returned from main of a test
+inline int test_exit_code() {
+    if (test_failures() > 0) {
+        fprintf(stderr, "%i checks failed\n", test_failures());
+        return 1;
+    }
+    
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Parses a generated applist response of 500 titles and builds the AppInfoList of it,
+// and compares that with copying every title out of the arena into an own string.
+//
+//   build/applist_bench [iterations]
+
+#include "GameStreamClient.hpp"
+#include "xml.h"
+#include "errors.h"
+#include "TestSupport.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define APP_COUNT 500
+#define DEFAULT_ITERATION_COUNT 200
+
+// About one TCP segment of the response body
+#define CHUNK_SIZE 1448
+
+struct CopiedAppInfo {
+    std::string name;
+    int app_id;
+};
+
+static uint64_t get_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Titles of different lengths, in no particular order
+static std::string make_applist_xml() {
+    std::string xml = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<root status_code=\"200\">\n";
+    char app[256];
+    
+    for (int i = 0; i < APP_COUNT; i++) {
+        int id = 100000 + (i * 7919) % APP_COUNT;
+        snprintf(app, sizeof(app), "<App>\n<IsHdrSupported>0</IsHdrSupported>\n<AppTitle>Game %i%s</AppTitle>\n<ID>%i</ID>\n</App>\n",
+                 id, i % 3 == 0 ? " - Definitive Edition with all DLC" : (i % 3 == 1 ? " Remastered" : ""), id);
+        xml += app;
+    }
+    
+    xml += "</root>\n";
+    return xml;
+}
+
+static int parse_applist(const std::string &xml, PAPP_LIST list) {
+    PXML_STREAM stream = xml_applist_stream(list);
+    
+    for (size_t offset = 0; offset < xml.size(); offset += CHUNK_SIZE) {
+        if (xml_stream_write(stream, xml.data() + offset, std::min((size_t)CHUNK_SIZE, xml.size() - offset)) != GS_OK) {
+            xml_stream_free(stream);
+            return GS_INVALID;
+        }
+    }
+    return xml_stream_finish(stream);
+}
+
+// What the client did before: sort the entries, then copy each title
+static std::vector<CopiedAppInfo> copy_titles(APP_LIST &list) {
+    std::sort(list.apps.begin(), list.apps.end(), [&list](const APP_LIST_ENTRY &a, const APP_LIST_ENTRY &b) {
+        return list.names.compare(a.name_offset, a.name_length, list.names, b.name_offset, b.name_length) < 0;
+    });
+    
+    std::vector<CopiedAppInfo> app_list;
+    app_list.reserve(list.apps.size());
+    
+    for (auto &app: list.apps) {
+        app_list.push_back({ .name = list.names.substr(app.name_offset, app.name_length), .app_id = app.id });
+    }
+    return app_list;
+}
+
+static void check_results(const std::string &xml) {
+    APP_LIST copied_list;
+    CHECK(parse_applist(xml, &copied_list) == GS_OK);
+    CHECK(copied_list.apps.size() == APP_COUNT);
+    auto copied = copy_titles(copied_list);
+    
+    APP_LIST list;
+    CHECK(parse_applist(xml, &list) == GS_OK);
+    AppInfoList app_list(std::move(list));
+    CHECK(app_list.size() == APP_COUNT);
+    
+    if (app_list.size() != copied.size()) {
+        return;
+    }
+    
+    for (size_t i = 0; i < copied.size(); i++) {
+        CHECK(app_list.apps[i].name == copied[i].name);
+        CHECK(app_list.apps[i].app_id == copied[i].app_id);
+    }
+    
+    // A copy of the list keeps the titles after the original is gone
+    AppInfoList list_copy = app_list;
+    app_list = AppInfoList();
+    CHECK(list_copy.apps.front().name == copied.front().name);
+}
+
+template<typename Convert>
+static void run(const char *name, const std::string &xml, int iteration_count, Convert convert) {
+    uint64_t parse_time_us = 0, convert_time_us = 0;
+    
+    for (int i = 0; i < iteration_count; i++) {
+        APP_LIST list;
+        
+        uint64_t before_parse = get_time_us();
+        parse_applist(xml, &list);
+        uint64_t before_convert = get_time_us();
+        convert(list);
+        uint64_t after_convert = get_time_us();
+        
+        parse_time_us += before_convert - before_parse;
+        convert_time_us += after_convert - before_convert;
+    }
+    
+    printf("%-20s parse %8.1f us  sort and convert %8.1f us\n", name,
+           (double)parse_time_us / iteration_count, (double)convert_time_us / iteration_count);
+}
+
+int main(int argc, char **argv) {
+    int iteration_count = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATION_COUNT;
+    
+    if (iteration_count <= 0) {
+        return 1;
+    }
+    
+    std::string xml = make_applist_xml();
+    check_results(xml);
+    
+    if (test_failures() > 0) {
+        return test_exit_code();
+    }
+    
+    printf("%i apps, %zu bytes applist, %i iterations\n", APP_COUNT, xml.size(), iteration_count);
+    
+    run("copy every title", xml, iteration_count, [](APP_LIST &list) {
+        auto app_list = copy_titles(list);
+    });
+    
+    run("shared title arena", xml, iteration_count, [](APP_LIST &list) {
+        AppInfoList app_list(std::move(list));
+    });
+    return test_exit_code();
+}
@@ -0,0 +1,132 @@
+// Downmixes 5.1 and 7.1 packets of 240 frames to stereo with the SIMD path of
+// AudioDownmix, NEON or SSE2 by the target, and compares it with the scalar path.
+// The SIMD output is checked against the scalar one first, including the tail
+// frames which the vector loop leaves to the scalar loop, and full scale input.
+//
+//   build/downmix_bench [iterations]
+
+#include "AudioDownmix.hpp"
+#include "TestSupport.hpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define PACKET_FRAMES 240
+#define DEFAULT_ITERATION_COUNT 20000
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#define SIMD_NAME "NEON"
+#elif defined(__SSE2__)
+#define SIMD_NAME "SSE2"
+#else
+#define SIMD_NAME "none, scalar"
+#endif
+
+static uint64_t get_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Deterministic noise over the full s16 range, every few frames is at full scale to hit the saturation
+static std::vector<int16_t> make_input(int channels, int frames) {
+    std::vector<int16_t> input(channels * frames);
+    uint32_t state = 12345;
+    
+    for (size_t i = 0; i < input.size(); i++) {
+        state = state * 1664525 + 1013904223;
+        input[i] = (int16_t)(state >> 16);
+        
+        if ((i / channels) % 7 == 0) {
+            input[i] = (i / channels) % 2 ? INT16_MAX : INT16_MIN;
+        }
+    }
+    return input;
+}
+
+static void check_results(int channels) {
+    AudioDownmix downmix;
+    downmix.init(channels);
+    CHECK(downmix.channels() == channels);
+    
+    auto input = make_input(channels, PACKET_FRAMES);
+    
+    // Every frame count up to a packet, so each count of tail frames is covered
+    for (int frames = 1; frames <= PACKET_FRAMES; frames++) {
+        // Sized exactly, so a read past the input is caught by ASan
+        std::vector<int16_t> packet(input.begin(), input.begin() + frames * channels);
+        std::vector<int16_t> simd(frames * 2), scalar(frames * 2);
+        
+        downmix.process(packet.data(), frames, simd.data());
+        downmix.process_scalar(packet.data(), frames, scalar.data());
+        
+        if (simd != scalar) {
+            fprintf(stderr, "%i channels, %i frames: SIMD output differs\n", channels, frames);
+            CHECK(simd == scalar);
+            return;
+        }
+    }
+    
+    // Front left only, -6 dB to the left side
+    std::vector<int16_t> frame(channels, 0), output(2);
+    frame[0] = 16384;
+    downmix.process_scalar(frame.data(), 1, output.data());
+    CHECK(output[0] == 8192 && output[1] == 0);
+}
+
+template<typename Process>
+static double run(int channels, int iteration_count, Process process) {
+    AudioDownmix downmix;
+    downmix.init(channels);
+    
+    auto input = make_input(channels, PACKET_FRAMES);
+    std::vector<int16_t> output(PACKET_FRAMES * 2);
+    int64_t checksum = 0;
+    
+    uint64_t before = get_time_us();
+    
+    for (int i = 0; i < iteration_count; i++) {
+        process(downmix, input.data(), output.data());
+        checksum += output[i % output.size()];
+    }
+    
+    double time_ns = (double)(get_time_us() - before) * 1000 / iteration_count;
+    
+    // Keeps the loop from being optimized away
+    if (checksum == INT64_MIN) {
+        printf("\n");
+    }
+    return time_ns;
+}
+
+static void run_layout(const char *name, int channels, int iteration_count) {
+    double simd_ns = run(channels, iteration_count, [](const AudioDownmix &downmix, const int16_t *input, int16_t *output) {
+        downmix.process(input, PACKET_FRAMES, output);
+    });
+    
+    double scalar_ns = run(channels, iteration_count, [](const AudioDownmix &downmix, const int16_t *input, int16_t *output) {
+        downmix.process_scalar(input, PACKET_FRAMES, output);
+    });
+    
+    printf("%-4s SIMD %8.1f ns  scalar %8.1f ns per packet  (%.2fx)\n", name, simd_ns, scalar_ns, scalar_ns / simd_ns);
+}
+
+int main(int argc, char **argv) {
+    int iteration_count = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATION_COUNT;
+    
+    if (iteration_count <= 0) {
+        return 1;
+    }
+    
+    check_results(6);
+    check_results(8);
+    
+    if (test_failures() > 0) {
+        return test_exit_code();
+    }
+    
+    printf("%i frames per packet, %i iterations, SIMD: %s\n", PACKET_FRAMES, iteration_count, SIMD_NAME);
+    
+    run_layout("5.1", 6, iteration_count);
+    run_layout("7.1", 8, iteration_count);
+    return test_exit_code();
+}
@@ -0,0 +1,242 @@
+// Runs GameStreamClient against the local GameStream host stand-in: connect, pair,
+// applist and start are issued at once, on the task queue workers, while the server
+// data snapshots are replaced under them. The callbacks run on the main thread like
+// on the nanogui UI thread. Built with -fsanitize=thread it checks the task queue,
+// the server data registry and the shared curl state for races.
+//
+//   build/gamestream_client_test
+
+#include "GameStreamStandIn.hpp"
+#include "GameStreamClient.hpp"
+#include "Settings.hpp"
+#include "TestSupport.hpp"
+#include <nanogui/nanogui.h>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define ADDRESS "127.0.0.1"
+#define PIN "1234"
+#define CONCURRENT_REQUESTS 8
+#define LATENCY_MS 20
+#define CALLBACK_TIMEOUT_MS 20000
+
+static std::mutex ui_mutex;
+static std::vector<std::function<void()>> ui_callbacks;
+
+void nanogui::async(const std::function<void()> &func) {
+    std::lock_guard<std::mutex> guard(ui_mutex);
+    ui_callbacks.push_back(func);
+}
+
+// Runs the queued callbacks on this thread until done() or the timeout
+static bool run_ui_loop(const std::function<bool()> &done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(CALLBACK_TIMEOUT_MS);
+    
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            fprintf(stderr, "Callbacks timed out\n");
+            return false;
+        }
+        
+        std::vector<std::function<void()>> callbacks; {
+            std::lock_guard<std::mutex> guard(ui_mutex);
+            callbacks.swap(ui_callbacks);
+        }
+        
+        for (auto &callback: callbacks) {
+            callback();
+        }
+        
+        if (callbacks.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return true;
+}
+
+// Callback results of a batch of requests, only touched on the main thread
+struct Results {
+    int succeeded = 0;
+    int failed = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    template<typename T>
+    std::function<void(GSResult<T>)> callback(const std::function<void(const GSResult<T> &)> &check = nullptr) {
+        return [this, check](GSResult<T> result) {
+            if (result.isSuccess()) {
+                succeeded++;
+            } else {
+                failed++;
+            }
+            
+            if (check) {
+                check(result);
+            }
+        };
+    }
+    
+    bool wait(const char *name, int count) {
+        bool is_done = run_ui_loop([this, count] { return succeeded + failed >= count; });
+        long long elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        
+        printf("%-36s %2i ok, %2i failed in %4lld ms\n", name, succeeded, failed, elapsed_ms);
+        return is_done;
+    }
+};
+
+static bool is_valid_snapshot(const std::shared_ptr<const SERVER_DATA> &server_data) {
+    return server_data && server_data->hostname == "STANDIN-PC" &&
+           server_data->serverInfo.address != NULL && strcmp(server_data->serverInfo.address, ADDRESS) == 0;
+}
+
+static STREAM_CONFIGURATION stream_configuration() {
+    STREAM_CONFIGURATION config;
+    LiInitializeStreamConfiguration(&config);
+    config.width = 1280;
+    config.height = 720;
+    config.fps = 60;
+    config.audioConfiguration = AUDIO_CONFIGURATION_STEREO;
+    return config;
+}
+
+static void connect(GameStreamClient &client) {
+    Results results;
+    client.connect(ADDRESS, results.callback<SERVER_DATA>());
+    CHECK(results.wait("connect", 1));
+    CHECK(results.succeeded == 1);
+}
+
+static void check_connect(GameStreamClient &client) {
+    CHECK(client.server_data(ADDRESS) == nullptr);
+    
+    // Refused right away, on the calling thread
+    Results refused;
+    client.pair(ADDRESS, PIN, refused.callback<bool>());
+    client.applist(ADDRESS, refused.callback<AppInfoList>());
+    CHECK(refused.failed == 2);
+    
+    // Every connect publishes a new snapshot, while the others read the registry
+    Results results;
+    
+    for (int i = 0; i < CONCURRENT_REQUESTS; i++) {
+        client.connect(ADDRESS, results.callback<SERVER_DATA>([](const GSResult<SERVER_DATA> &result) {
+            CHECK(result.value().hostname == "STANDIN-PC");
+        }));
+    }
+    
+    CHECK(results.wait("connect x8", CONCURRENT_REQUESTS));
+    CHECK(results.succeeded == CONCURRENT_REQUESTS);
+    
+    auto server_data = client.server_data(ADDRESS);
+    CHECK(is_valid_snapshot(server_data));
+    CHECK(server_data && !server_data->paired);
+    
+    Results applist;
+    client.applist(ADDRESS, applist.callback<AppInfoList>());
+    CHECK(applist.wait("applist, not paired", 1));
+    CHECK(applist.failed == 1);
+}
+
+static void check_pair(GameStreamClient &client, GameStreamStandIn &stand_in) {
+    auto before = client.server_data(ADDRESS);
+    
+    // Pairing resets the shared TLS sessions, while connects and applists run on the
+    // other workers. The applists may run before or after the pairing finished.
+    Results pair, others;
+    client.pair(ADDRESS, PIN, pair.callback<bool>());
+    
+    for (int i = 0; i < CONCURRENT_REQUESTS; i++) {
+        client.connect(ADDRESS, others.callback<SERVER_DATA>());
+        client.applist(ADDRESS, others.callback<AppInfoList>());
+    }
+    
+    CHECK(pair.wait("pair", 1));
+    CHECK(others.wait("connect and applist x8, pairing", CONCURRENT_REQUESTS * 2));
+    CHECK(pair.succeeded == 1);
+    CHECK(stand_in.is_paired());
+    
+    // A snapshot doesn't change once published, the holder keeps it alive
+    CHECK(is_valid_snapshot(before));
+    CHECK(before && !before->paired);
+    
+    // A connect which started before the pairing finished may publish the unpaired
+    // state after it, the next one has the state of the host
+    connect(client);
+    auto after = client.server_data(ADDRESS);
+    CHECK(is_valid_snapshot(after));
+    CHECK(after && after->paired);
+}
+
+static void check_start(GameStreamClient &client, GameStreamStandIn &stand_in) {
+    const int app_id = GameStreamStandIn::app_id(1);
+    
+    Results start, applist, others;
+    client.start(ADDRESS, stream_configuration(), app_id, start.callback<STREAM_CONFIGURATION>());
+    
+    for (int i = 0; i < CONCURRENT_REQUESTS; i++) {
+        client.applist(ADDRESS, applist.callback<AppInfoList>([](const GSResult<AppInfoList> &result) {
+            auto list = result.value();
+            CHECK(list.size() == 3);
+            
+            for (size_t i = 1; i < list.apps.size(); i++) {
+                CHECK(list.apps[i - 1].name < list.apps[i].name);
+            }
+        }));
+        client.connect(ADDRESS, others.callback<SERVER_DATA>());
+    }
+    
+    CHECK(start.wait("start", 1));
+    CHECK(applist.wait("applist x8, starting", CONCURRENT_REQUESTS));
+    CHECK(others.wait("connect x8, starting", CONCURRENT_REQUESTS));
+    CHECK(start.succeeded == 1);
+    CHECK(applist.succeeded == CONCURRENT_REQUESTS);
+    CHECK(others.succeeded == CONCURRENT_REQUESTS);
+    CHECK(stand_in.current_game() == app_id);
+    CHECK(stand_in.requests("launch") == 1);
+    
+    connect(client);
+    auto server_data = client.server_data(ADDRESS);
+    CHECK(server_data && server_data->currentGame == app_id);
+    
+    Results quit;
+    client.quit(ADDRESS, quit.callback<bool>());
+    CHECK(quit.wait("quit", 1));
+    CHECK(quit.succeeded == 1);
+    CHECK(stand_in.current_game() == 0);
+}
+
+int main(int argc, char **argv) {
+    // The client certificate and the added host go to the working directory
+    char working_dir[] = "/tmp/gamestream_client_test_XXXXXX";
+    if (!mkdtemp(working_dir)) {
+        return 1;
+    }
+    
+    Settings::instance().set_working_dir(working_dir);
+    Settings::instance().set_ignore_unsupported_resolutions(false);
+    
+    // Requests take a while, so the workers overlap
+    StandInConfig config;
+    config.latency_ms = LATENCY_MS;
+    GameStreamStandIn stand_in(config);
+    
+    if (!stand_in.is_running()) {
+        return 1;
+    }
+    
+    GameStreamClient &client = GameStreamClient::instance();
+    client.start();
+    
+    check_connect(client);
+    check_pair(client, stand_in);
+    check_start(client, stand_in);
+    
+    client.stop();
+    return test_exit_code();
+}
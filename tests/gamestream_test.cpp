@@ -0,0 +1,264 @@
+// Runs libgamestream against a local GameStream host stand-in, through gs_init,
+// gs_pair, gs_applist, gs_app_boxart, gs_start_app and gs_quit_app, then with
+// latency and failing endpoints. Prints the time of every step.
+//
+//   build/gamestream_test [-v]
+
+#include "GameStreamStandIn.hpp"
+#include "client.h"
+#include "errors.h"
+#include "Settings.hpp"
+#include "TestSupport.hpp"
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ADDRESS "127.0.0.1"
+#define PIN "1234"
+#define LATENCY_MS 150
+
+static void free_modes(PSERVER_DATA server) {
+    while (server->modes != NULL) {
+        PDISPLAY_MODE next = server->modes->next;
+        free(server->modes);
+        server->modes = next;
+    }
+}
+
+// gs_init replaces the display modes without freeing them
+static int init(PSERVER_DATA server) {
+    free_modes(server);
+    return gs_init(server, ADDRESS);
+}
+
+static int step(const char *name, const std::function<int()> &perform) {
+    auto start = std::chrono::steady_clock::now();
+    int result = perform();
+    long long elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    
+    printf("%-28s %4i in %4lld ms%s%s\n", name, result, elapsed_ms, result != GS_OK ? ", " : "", result != GS_OK ? gs_error().c_str() : "");
+    return result;
+}
+
+static STREAM_CONFIGURATION stream_configuration(int width, int height, int fps) {
+    STREAM_CONFIGURATION config;
+    LiInitializeStreamConfiguration(&config);
+    config.width = width;
+    config.height = height;
+    config.fps = fps;
+    config.audioConfiguration = AUDIO_CONFIGURATION_STEREO;
+    return config;
+}
+
+static void run_session(GameStreamStandIn &stand_in) {
+    SERVER_DATA server = {};
+    
+    // HTTPS refuses an unknown client, so it's the HTTP answer
+    CHECK(step("init, not paired", [&] { return init(&server); }) == GS_OK);
+    CHECK(!server.paired);
+    CHECK(server.hostname == "STANDIN-PC");
+    CHECK(server.serverMajorVersion == 7);
+    CHECK(server.currentGame == 0);
+    CHECK(stand_in.requests("serverinfo") == 2);
+    
+    APP_LIST list;
+    CHECK(step("applist, not paired", [&] { return gs_applist(&server, &list); }) == GS_ERROR);
+    CHECK(list.apps.empty());
+    
+    // The host notices the wrong PIN on the last stage, the HTTPS challenge fails then
+    char wrong_pin[] = "0000";
+    CHECK(step("pair, wrong PIN", [&] { return gs_pair(&server, wrong_pin); }) != GS_OK);
+    CHECK(!server.paired);
+    CHECK(!stand_in.is_paired());
+    CHECK(stand_in.requests("unpair") == 1);
+    
+    char pin[] = PIN;
+    CHECK(step("pair", [&] { return gs_pair(&server, pin); }) == GS_OK);
+    CHECK(server.paired);
+    CHECK(stand_in.is_paired());
+    
+    // Pairing drops the TLS sessions and connections of the unpaired client,
+    // then one connection serves the HTTPS requests
+    int handshakes = stand_in.tls_handshakes();
+    int resumed_handshakes = stand_in.resumed_tls_handshakes();
+    
+    CHECK(step("init, paired", [&] { return init(&server); }) == GS_OK);
+    CHECK(server.paired);
+    CHECK(stand_in.tls_handshakes() == handshakes + 1);
+    CHECK(stand_in.resumed_tls_handshakes() == resumed_handshakes);
+    
+    CHECK(step("applist", [&] { return gs_applist(&server, &list); }) == GS_OK);
+    CHECK(list.apps.size() == 3);
+    CHECK(stand_in.tls_handshakes() == handshakes + 1);
+    
+    for (size_t i = 0; i < list.apps.size(); i++) {
+        CHECK(list.names.compare(list.apps[i].name_offset, list.apps[i].name_length, GameStreamStandIn::app_title(i)) == 0);
+        CHECK(list.apps[i].id == GameStreamStandIn::app_id(i));
+    }
+    
+    Data boxart;
+    CHECK(step("boxart", [&] { return gs_app_boxart(&server, GameStreamStandIn::app_id(0), &boxart); }) == GS_OK);
+    CHECK(boxart.size() == StandInConfig().boxart_size);
+    CHECK(boxart.size() > 4 && memcmp(boxart.bytes(), "\x89PNG", 4) == 0);
+    
+    // Refused by the client, the host has no 1080p 144 Hz mode
+    STREAM_CONFIGURATION config = stream_configuration(1920, 1080, 144);
+    CHECK(step("launch, unsupported mode", [&] { return gs_start_app(&server, &config, GameStreamStandIn::app_id(1), false, false, 1); }) == GS_NOT_SUPPORTED_MODE);
+    CHECK(stand_in.requests("launch") == 0);
+    
+    config = stream_configuration(1920, 1080, 60);
+    CHECK(step("launch", [&] { return gs_start_app(&server, &config, GameStreamStandIn::app_id(1), false, false, 1); }) == GS_OK);
+    CHECK(server.currentGame == GameStreamStandIn::app_id(1));
+    CHECK(stand_in.current_game() == GameStreamStandIn::app_id(1));
+    
+    // A running game is resumed
+    CHECK(step("init, in game", [&] { return init(&server); }) == GS_OK);
+    CHECK(server.currentGame == GameStreamStandIn::app_id(1));
+    CHECK(step("resume", [&] { return gs_start_app(&server, &config, GameStreamStandIn::app_id(1), false, false, 1); }) == GS_OK);
+    CHECK(stand_in.requests("resume") == 1);
+    CHECK(stand_in.requests("launch") == 1);
+    
+    CHECK(step("quit", [&] { return gs_quit_app(&server); }) == GS_OK);
+    CHECK(stand_in.current_game() == 0);
+    CHECK(step("init, after quit", [&] { return init(&server); }) == GS_OK);
+    CHECK(server.currentGame == 0);
+    
+    free_modes(&server);
+}
+
+static void run_failures(GameStreamStandIn &stand_in) {
+    SERVER_DATA server = {};
+    CHECK(init(&server) == GS_OK);
+    CHECK(server.paired);
+    
+    auto fail = [&stand_in](const std::string &endpoint, StandInFailure failure) {
+        StandInConfig config;
+        config.failures[endpoint] = failure;
+        stand_in.set_config(config);
+    };
+    
+    fail("serverinfo", StandInFailure::HttpError);
+    CHECK(step("init, HTTP error", [&] { return init(&server); }) != GS_OK);
+    
+    fail("serverinfo", StandInFailure::DropConnection);
+    CHECK(step("init, dropped connection", [&] { return init(&server); }) != GS_OK);
+    
+    fail("serverinfo", StandInFailure::MalformedXml);
+    CHECK(step("init, malformed XML", [&] { return init(&server); }) == GS_INVALID);
+    
+    fail("serverinfo", StandInFailure::StatusCode);
+    CHECK(step("init, status code", [&] { return init(&server); }) == GS_ERROR);
+    CHECK(gs_error() == "Service Unavailable");
+    
+    stand_in.set_config(StandInConfig());
+    CHECK(init(&server) == GS_OK);
+    
+    APP_LIST list;
+    fail("applist", StandInFailure::DropConnection);
+    CHECK(step("applist, dropped connection", [&] { return gs_applist(&server, &list); }) == GS_IO_ERROR);
+    CHECK(list.apps.empty());
+    
+    // The next connection resumes the TLS session
+    int resumed_handshakes = stand_in.resumed_tls_handshakes();
+    
+    // A partial list isn't handed out
+    fail("applist", StandInFailure::MalformedXml);
+    CHECK(step("applist, malformed XML", [&] { return gs_applist(&server, &list); }) == GS_INVALID);
+    CHECK(list.apps.empty() && list.names.empty());
+    CHECK(stand_in.resumed_tls_handshakes() == resumed_handshakes + 1);
+    
+    fail("applist", StandInFailure::StatusCode);
+    CHECK(step("applist, status code", [&] { return gs_applist(&server, &list); }) == GS_ERROR);
+    
+    Data boxart;
+    fail("appasset", StandInFailure::HttpError);
+    CHECK(step("boxart, HTTP error", [&] { return gs_app_boxart(&server, GameStreamStandIn::app_id(0), &boxart); }) == GS_IO_ERROR);
+    CHECK(boxart.is_empty());
+    
+    // The game isn't counted as running when the host refuses the launch
+    STREAM_CONFIGURATION config = stream_configuration(1280, 720, 60);
+    fail("launch", StandInFailure::StatusCode);
+    CHECK(step("launch, status code", [&] { return gs_start_app(&server, &config, GameStreamStandIn::app_id(0), false, false, 1); }) == GS_ERROR);
+    CHECK(server.currentGame == 0);
+    
+    stand_in.set_config(StandInConfig());
+    CHECK(gs_start_app(&server, &config, GameStreamStandIn::app_id(0), false, false, 1) == GS_OK);
+    
+    fail("cancel", StandInFailure::HttpError);
+    CHECK(step("quit, HTTP error", [&] { return gs_quit_app(&server); }) != GS_OK);
+    CHECK(stand_in.current_game() == GameStreamStandIn::app_id(0));
+    
+    stand_in.set_config(StandInConfig());
+    CHECK(gs_quit_app(&server) == GS_OK);
+    
+    free_modes(&server);
+}
+
+static void run_latency(GameStreamStandIn &stand_in) {
+    SERVER_DATA server = {};
+    StandInConfig config;
+    config.latency_ms = LATENCY_MS;
+    config.app_count = 500;
+    config.boxart_size = 512 * 1024;
+    stand_in.set_config(config);
+    
+    auto elapsed_ms = [](const std::function<int()> &perform, int expected) {
+        auto start = std::chrono::steady_clock::now();
+        CHECK(perform() == expected);
+        return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+    
+    long long init_ms = elapsed_ms([&] { return init(&server); }, GS_OK);
+    printf("%-28s %4lld ms with %i ms latency\n", "init", init_ms, LATENCY_MS);
+    CHECK(init_ms >= LATENCY_MS);
+    
+    APP_LIST list;
+    long long applist_ms = elapsed_ms([&] { return gs_applist(&server, &list); }, GS_OK);
+    printf("%-28s %4lld ms for %zu apps\n", "applist", applist_ms, list.apps.size());
+    CHECK(list.apps.size() == 500);
+    
+    Data boxart;
+    long long boxart_ms = elapsed_ms([&] { return gs_app_boxart(&server, GameStreamStandIn::app_id(499), &boxart); }, GS_OK);
+    printf("%-28s %4lld ms for %zu bytes\n", "boxart", boxart_ms, boxart.size());
+    CHECK(boxart.size() == config.boxart_size);
+    
+    // An unpaired client asks HTTPS and HTTP at once, so it waits for the latency once
+    SERVER_DATA other_server = {};
+    CHECK(gs_unpair(&server) == GS_OK);
+    long long unpaired_init_ms = elapsed_ms([&] { return init(&other_server); }, GS_OK);
+    printf("%-28s %4lld ms with %i ms latency\n", "init, not paired", unpaired_init_ms, LATENCY_MS);
+    CHECK(!other_server.paired);
+    CHECK(unpaired_init_ms < LATENCY_MS * 2);
+    
+    stand_in.set_config(StandInConfig());
+    free_modes(&server);
+    free_modes(&other_server);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "-v") == 0) {
+        Settings::instance().set_write_log(true);
+    }
+    
+    // The client certificate goes to the key directory
+    char working_dir[] = "/tmp/gamestream_test_XXXXXX";
+    if (!mkdtemp(working_dir)) {
+        return 1;
+    }
+    
+    Settings::instance().set_working_dir(working_dir);
+    Settings::instance().set_ignore_unsupported_resolutions(false);
+    
+    GameStreamStandIn stand_in;
+    
+    if (!stand_in.is_running()) {
+        return 1;
+    }
+    
+    run_session(stand_in);
+    run_failures(stand_in);
+    run_latency(stand_in);
+    return test_exit_code();
+}
@@ -0,0 +1,201 @@
+// Drives GLVideoRenderer::draw with synthetic YUV frames on an offscreen EGL context
+// (surfaceless Mesa, e.g. llvmpipe on a Linux box without GPU), and compares the
+// direct glTexSubImage2D upload with the PBO upload.
+//
+//   build/gl_upload_bench [-v] [frames]
+
+#include "GLVideoRenderer.hpp"
+#include "Settings.hpp"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libavutil/pixdesc.h>
+}
+
+#define DEFAULT_FRAME_COUNT 120
+#define WARMUP_FRAME_COUNT 10
+
+struct BenchConfig {
+    int width;
+    int height;
+    AVPixelFormat format;
+    bool is_hdr; // BT.2020 PQ, tone mapped by the shader
+};
+
+static const BenchConfig configs[] = {
+    { 1280, 720, AV_PIX_FMT_YUV420P, false },
+    { 1280, 720, AV_PIX_FMT_YUV420P10, false },
+    { 1920, 1080, AV_PIX_FMT_YUV420P, false },
+    { 1920, 1080, AV_PIX_FMT_YUV420P10, false },
+    { 1920, 1080, AV_PIX_FMT_YUV420P10, true }
+};
+
+static uint64_t get_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool create_context() {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    
+    EGLint major, minor;
+    if (!eglInitialize(display, &major, &minor)) {
+        fprintf(stderr, "eglInitialize failed: 0x%x\n", eglGetError());
+        return false;
+    }
+    
+    eglBindAPI(EGL_OPENGL_API);
+    
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        fprintf(stderr, "Surfaceless GL 3.3 context failed: 0x%x\n", eglGetError());
+        return false;
+    }
+    
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        fprintf(stderr, "gladLoadGLLoader failed\n");
+        return false;
+    }
+    
+    printf("EGL %i.%i, %s, %s\n", major, minor, glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    return true;
+}
+
+// A moving gradient, so every frame is new for the driver
+static void fill_frame(AVFrame *frame, int index) {
+    bool is_10bit = frame->format == AV_PIX_FMT_YUV420P10;
+    
+    for (int plane = 0; plane < 3; plane++) {
+        int width = plane > 0 ? frame->width / 2 : frame->width;
+        int height = plane > 0 ? frame->height / 2 : frame->height;
+        
+        for (int y = 0; y < height; y++) {
+            uint8_t *row = frame->data[plane] + (size_t)y * frame->linesize[plane];
+            
+            for (int x = 0; x < width; x++) {
+                int value = (x + y + index) & 0xFF;
+                
+                if (is_10bit) {
+                    ((uint16_t *)row)[x] = value << 2;
+                } else {
+                    row[x] = value;
+                }
+            }
+        }
+    }
+}
+
+static void run(const BenchConfig &config, bool use_pbo, int frame_count) {
+    AVFrame *frame = av_frame_alloc();
+    frame->width = config.width;
+    frame->height = config.height;
+    frame->format = config.format;
+    frame->color_range = AVCOL_RANGE_MPEG;
+    frame->colorspace = config.is_hdr ? AVCOL_SPC_BT2020_NCL : AVCOL_SPC_BT709;
+    frame->color_primaries = config.is_hdr ? AVCOL_PRI_BT2020 : AVCOL_PRI_BT709;
+    frame->color_trc = config.is_hdr ? AVCOL_TRC_SMPTE2084 : AVCOL_TRC_BT709;
+    
+    if (av_frame_get_buffer(frame, 64) < 0) {
+        fprintf(stderr, "av_frame_get_buffer failed\n");
+        exit(1);
+    }
+    
+    // The renderer draws into the bound framebuffer, like into the nanogui one
+    GLuint framebuffer, renderbuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, config.width, config.height);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+    
+    uint64_t total_frame_time_us = 0;
+    uint64_t upload_time_us = 0, draw_time_us = 0;
+    
+    {
+        GLVideoRenderer renderer(use_pbo);
+        
+        for (int i = 0; i < WARMUP_FRAME_COUNT; i++) {
+            fill_frame(frame, i);
+            renderer.draw(config.width, config.height, frame);
+        }
+        glFinish();
+        
+        VideoRenderStats warmup_stats = *renderer.video_render_stats();
+        
+        for (int i = 0; i < frame_count; i++) {
+            fill_frame(frame, WARMUP_FRAME_COUNT + i);
+            
+            // glFinish counts the GPU side of the upload and the draw as well
+            uint64_t before_frame = get_time_us();
+            renderer.draw(config.width, config.height, frame);
+            glFinish();
+            total_frame_time_us += get_time_us() - before_frame;
+        }
+        
+        VideoRenderStats *stats = renderer.video_render_stats();
+        upload_time_us = stats->total_upload_time_us - warmup_stats.total_upload_time_us;
+        draw_time_us = stats->total_draw_time_us - warmup_stats.total_draw_time_us;
+    }
+    
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        fprintf(stderr, "GL error: 0x%x\n", error);
+        exit(1);
+    }
+    
+    printf("%4ix%-4i %-12s %-3s %-6s upload %8.1f us  draw %8.1f us  frame %8.1f us\n",
+           config.width, config.height, av_get_pix_fmt_name(config.format), config.is_hdr ? "hdr" : "sdr", use_pbo ? "pbo" : "direct",
+           (double)upload_time_us / frame_count, (double)draw_time_us / frame_count, (double)total_frame_time_us / frame_count);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &renderbuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    av_frame_free(&frame);
+}
+
+int main(int argc, char **argv) {
+    int frame_count = DEFAULT_FRAME_COUNT;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            // Renderer logs, like the shader compile errors
+            Settings::instance().set_write_log(true);
+        } else {
+            frame_count = atoi(argv[i]);
+        }
+    }
+    
+    if (frame_count <= 0 || !create_context()) {
+        return 1;
+    }
+    
+    printf("%i frames per run, upload and draw are CPU time of the calls, frame includes glFinish\n", frame_count);
+    
+    for (auto &config: configs) {
+        run(config, false, frame_count);
+        run(config, true, frame_count);
+    }
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Checks AudioJitterBuffer and AudioResampler with synthetic packet arrival times
+// and signals, without a clock or a decoder: the jitter estimate and the target
+// latency, the PI controller against a simulated drifting sink, the Q14 lerp of
+// the resampler, and its SIMD stereo path against the scalar one.
+//
+//   build/jitter_buffer_test
+
+#include "AudioJitterBuffer.hpp"
+#include "AudioResampler.hpp"
+#include "TestSupport.hpp"
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define SAMPLE_RATE 48000
+#define PACKET_FRAMES 240
+#define PACKET_US 5000
+
+// The limits of AudioJitterBuffer
+#define MIN_TARGET_MS 20.0f
+#define MAX_TARGET_MS 120.0f
+
+static bool is_near(double value, double expected, double tolerance) {
+    return fabs(value - expected) <= tolerance;
+}
+
+static void check_target() {
+    AudioJitterBuffer jitter_buffer;
+    jitter_buffer.reset(SAMPLE_RATE, PACKET_FRAMES);
+    uint64_t now_us = 1000000;
+    
+    // Packets on time, the target stays at the minimum
+    for (int i = 0; i < 200; i++) {
+        jitter_buffer.packet_arrived(now_us += PACKET_US);
+    }
+    
+    printf("steady       jitter %5.2f ms  target %6.2f ms\n", jitter_buffer.jitter_ms(), jitter_buffer.target_ms());
+    CHECK(jitter_buffer.jitter_ms() == 0);
+    CHECK(jitter_buffer.target_ms() == MIN_TARGET_MS);
+    CHECK(jitter_buffer.target_frames() == MIN_TARGET_MS * SAMPLE_RATE / 1000);
+    
+    // Every packet 2 ms early or late, the estimate converges to 2 ms and the target to 20 + 3 * 2 ms
+    for (int i = 0; i < 400; i++) {
+        jitter_buffer.packet_arrived(now_us += PACKET_US + (i % 2 ? 2000 : -2000));
+    }
+    
+    printf("2 ms jitter  jitter %5.2f ms  target %6.2f ms\n", jitter_buffer.jitter_ms(), jitter_buffer.target_ms());
+    CHECK(is_near(jitter_buffer.jitter_ms(), 2, 0.01));
+    CHECK(is_near(jitter_buffer.target_ms(), 26, 0.05));
+    
+    // An underrun adds 10 ms, it decays by 1 ms per second
+    float target_ms = jitter_buffer.target_ms();
+    jitter_buffer.underrun_happened();
+    jitter_buffer.packet_arrived(now_us += PACKET_US + 2000);
+    printf("underrun     jitter %5.2f ms  target %6.2f ms\n", jitter_buffer.jitter_ms(), jitter_buffer.target_ms());
+    CHECK(is_near(jitter_buffer.target_ms(), target_ms + 10, 0.1));
+    
+    for (int i = 0; i < 1000; i++) {
+        jitter_buffer.packet_arrived(now_us += PACKET_US + (i % 2 ? -2000 : 2000));
+    }
+    
+    printf("5 s later    jitter %5.2f ms  target %6.2f ms\n", jitter_buffer.jitter_ms(), jitter_buffer.target_ms());
+    CHECK(is_near(jitter_buffer.target_ms(), target_ms + 5, 0.1));
+    
+    // The A/V sync bounds clamp it, within the own limits
+    jitter_buffer.set_latency_bounds(60, 0);
+    jitter_buffer.packet_arrived(now_us += PACKET_US);
+    CHECK(jitter_buffer.target_ms() == 60);
+    
+    jitter_buffer.set_latency_bounds(0, 22);
+    jitter_buffer.packet_arrived(now_us += PACKET_US);
+    CHECK(jitter_buffer.target_ms() == 22);
+    
+    jitter_buffer.set_latency_bounds(500, 0);
+    jitter_buffer.packet_arrived(now_us += PACKET_US);
+    CHECK(jitter_buffer.target_ms() == MAX_TARGET_MS);
+}
+
+static void check_ratio() {
+    AudioJitterBuffer jitter_buffer;
+    jitter_buffer.reset(SAMPLE_RATE, PACKET_FRAMES);
+    int target_frames = jitter_buffer.target_frames();
+    
+    CHECK(jitter_buffer.resample_ratio(target_frames) == 1.0);
+    
+    // A fuller queue is consumed faster, an emptier one slower
+    CHECK(jitter_buffer.resample_ratio(target_frames + 480) > 1.0);
+    jitter_buffer.reset(SAMPLE_RATE, PACKET_FRAMES);
+    CHECK(jitter_buffer.resample_ratio(target_frames - 480) < 1.0);
+    
+    // The speed change is bounded
+    jitter_buffer.reset(SAMPLE_RATE, PACKET_FRAMES);
+    double ratio = 1.0;
+    
+    for (int i = 0; i < 100; i++) {
+        ratio = jitter_buffer.resample_ratio(target_frames + 48000);
+    }
+    CHECK(ratio > 1.0 && ratio <= 1.021);
+}
+
+// Packets arrive on time, the sink plays sink_ppm faster than the host sends.
+// Gives the mean queue error in frames and the mean ratio over the last second.
+static void run_drift(int sink_ppm, int seconds, AudioJitterBuffer *jitter_buffer, double *error_frames, double *ratio) {
+    jitter_buffer->reset(SAMPLE_RATE, PACKET_FRAMES);
+    int target_frames = jitter_buffer->target_frames();
+    
+    double queued_frames = target_frames;
+    int packets = seconds * 1000000 / PACKET_US;
+    int last_second = 1000000 / PACKET_US;
+    uint64_t now_us = 1000000;
+    
+    *error_frames = 0;
+    *ratio = 0;
+    
+    for (int i = 0; i < packets; i++) {
+        jitter_buffer->packet_arrived(now_us += PACKET_US);
+        
+        double packet_ratio = jitter_buffer->resample_ratio((int)queued_frames);
+        queued_frames += PACKET_FRAMES / packet_ratio;
+        queued_frames -= PACKET_FRAMES * (1 + sink_ppm / 1e6);
+        
+        if (i >= packets - last_second) {
+            *error_frames += (queued_frames - target_frames) / last_second;
+            *ratio += packet_ratio / last_second;
+        }
+    }
+}
+
+static void check_drift() {
+    const int sink_ppm[] = { 300, -300, 0 };
+    
+    for (int ppm: sink_ppm) {
+        AudioJitterBuffer jitter_buffer;
+        double error_frames, ratio;
+        run_drift(ppm, 120, &jitter_buffer, &error_frames, &ratio);
+        
+        // The sink consumes more, so every packet is stretched by its drift. The proportional
+        // part does it at first with a small standing error, the integral part takes it over
+        // in minutes, without overshooting.
+        printf("sink %+4i ppm  ratio %.6f  drift %+6.1f ppm  queue error %+6.1f frames\n", ppm, ratio, jitter_buffer.drift_ppm(), error_frames);
+        CHECK(is_near(ratio, 1 / (1 + ppm / 1e6), 5e-6));
+        CHECK(is_near(error_frames, 0, SAMPLE_RATE / 1000));
+        CHECK(ppm == 0 ? jitter_buffer.drift_ppm() == 0 : jitter_buffer.drift_ppm() * -ppm > 0 && fabs(jitter_buffer.drift_ppm()) < abs(ppm));
+        
+        // The standing error shrinks as the drift estimate grows
+        double later_error_frames;
+        run_drift(ppm, 600, &jitter_buffer, &later_error_frames, &ratio);
+        printf("after 600 s   ratio %.6f  drift %+6.1f ppm  queue error %+6.1f frames\n", ratio, jitter_buffer.drift_ppm(), later_error_frames);
+        CHECK(fabs(later_error_frames) <= fabs(error_frames));
+        CHECK(is_near(jitter_buffer.drift_ppm(), -ppm, abs(ppm) / 2));
+    }
+}
+
+static void check_lerp() {
+    AudioResampler resampler;
+    resampler.reset(1);
+    
+    const int16_t input[] = { 0, 1000, -1000, 32767, -32768, 7, 8, 9 };
+    const int input_frames = sizeof(input) / sizeof(input[0]);
+    
+    // At ratio 1 the input comes out as is, one frame later
+    int16_t output[64];
+    int frames = resampler.process(input, input_frames, output, 64);
+    CHECK(frames == input_frames - 1);
+    
+    for (int i = 0; i < frames; i++) {
+        CHECK(output[i] == input[i]);
+    }
+    
+    frames = resampler.process(input, input_frames, output, 64);
+    CHECK(frames == input_frames);
+    CHECK(output[0] == input[input_frames - 1]);
+    
+    // At ratio 0.25 the weights are exact quarters in Q14, the lerp is floored
+    resampler.reset(1);
+    resampler.set_ratio(0.25);
+    frames = resampler.process(input, input_frames, output, 64);
+    CHECK(frames == (input_frames - 1) * 4);
+    
+    for (int i = 0; i < frames; i++) {
+        int a = input[i / 4], b = input[i / 4 + 1];
+        int w = (i % 4) * 4096;
+        int expected = (int)floor((a * (16384.0 - w) + b * w) / 16384);
+        
+        if (output[i] != expected) {
+            fprintf(stderr, "frame %i: %i instead of %i\n", i, output[i], expected);
+            CHECK(output[i] == expected);
+        }
+    }
+}
+
+// Stereo noise, packets resampled with ratios like the controller gives
+static void check_simd(int channels) {
+    AudioResampler simd, scalar;
+    simd.reset(channels);
+    scalar.reset(channels);
+    
+    std::vector<int16_t> input(PACKET_FRAMES * channels);
+    std::vector<int16_t> simd_output(PACKET_FRAMES * 2 * channels), scalar_output(PACKET_FRAMES * 2 * channels);
+    int max_output_frames = PACKET_FRAMES * 2;
+    uint32_t state = 12345;
+    int total_frames = 0;
+    
+    for (int packet = 0; packet < 2000; packet++) {
+        for (auto &sample: input) {
+            state = state * 1664525 + 1013904223;
+            sample = (int16_t)(state >> 16);
+        }
+        
+        double ratio = 1.0 + 0.02 * sin(packet * 0.05) + (packet % 100 == 0 ? 0.4 : 0);
+        simd.set_ratio(ratio);
+        scalar.set_ratio(ratio);
+        
+        int simd_frames = simd.process(input.data(), PACKET_FRAMES, simd_output.data(), max_output_frames);
+        int scalar_frames = scalar.process_scalar(input.data(), PACKET_FRAMES, scalar_output.data(), max_output_frames);
+        
+        if (simd_frames != scalar_frames || memcmp(simd_output.data(), scalar_output.data(), simd_frames * channels * sizeof(int16_t)) != 0) {
+            fprintf(stderr, "%i channels, packet %i: SIMD output differs\n", channels, packet);
+            CHECK(false);
+            return;
+        }
+        total_frames += simd_frames;
+    }
+    
+    printf("%i channels   %i frames resampled, SIMD matches scalar\n", channels, total_frames);
+}
+
+int main(int argc, char **argv) {
+    check_target();
+    check_ratio();
+    check_drift();
+    check_lerp();
+    check_simd(2);
+    check_simd(6);
+    return test_exit_code();
+}
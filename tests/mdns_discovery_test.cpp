@@ -0,0 +1,259 @@
+// Runs discover_mdns_hosts against a local mDNS responder stand-in on loopback,
+// with answer latency, dropped queries and different responses. Prints the time
+// until every host was reported.
+//
+//   build/mdns_discovery_test
+
+#include "MdnsDiscovery.hpp"
+#include "TestSupport.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define DISCOVERY_TIMEOUT_MS 1000
+
+struct ResponderConfig {
+    int latency_ms = 0;
+    // Lost queries, like on a WiFi with interference
+    int dropped_queries = 0;
+    // A records in the additional section, the sender address is used without them
+    std::vector<std::string> addresses;
+    std::string service = "_nvstream._tcp.local";
+};
+
+// Answers _nvstream._tcp PTR queries by unicast, like GFE and Sunshine do for
+// queries from an ephemeral port
+class MdnsResponderStandIn {
+public:
+    MdnsResponderStandIn(const ResponderConfig &config): m_config(config) {
+        m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(m_socket, (struct sockaddr *)&addr, sizeof(addr));
+        
+        socklen_t length = sizeof(addr);
+        getsockname(m_socket, (struct sockaddr *)&addr, &length);
+        m_port = ntohs(addr.sin_port);
+        
+        m_thread = std::thread([this] { loop(); });
+    }
+    
+    ~MdnsResponderStandIn() {
+        m_is_running = false;
+        m_thread.join();
+        close(m_socket);
+    }
+    
+    unsigned short port() const {
+        return m_port;
+    }
+    
+    int queries() const {
+        return m_queries;
+    }
+    
+private:
+    void loop() {
+        while (m_is_running) {
+            struct pollfd fd = { m_socket, POLLIN, 0 };
+            if (poll(&fd, 1, 20) <= 0) {
+                continue;
+            }
+            
+            unsigned char query[1500];
+            struct sockaddr_in sender;
+            socklen_t sender_length = sizeof(sender);
+            long length = recvfrom(m_socket, query, sizeof(query), 0, (struct sockaddr *)&sender, &sender_length);
+            
+            // One PTR question for the nvstream service
+            static const unsigned char question[] = "\x09_nvstream\x04_tcp\x05local\x00\x00\x0c";
+            if (length < 12 + (long)sizeof(question) || query[5] != 1 || memcmp(query + 12, question, sizeof(question) - 1) != 0) {
+                continue;
+            }
+            
+            if (m_queries++ < m_config.dropped_queries) {
+                continue;
+            }
+            
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_config.latency_ms));
+            
+            std::vector<unsigned char> response = create_response();
+            sendto(m_socket, response.data(), response.size(), 0, (struct sockaddr *)&sender, sender_length);
+        }
+    }
+    
+    static void append_name(std::vector<unsigned char> &data, const std::string &name) {
+        size_t start = 0;
+        
+        while (start < name.size()) {
+            size_t end = name.find('.', start);
+            if (end == std::string::npos) {
+                end = name.size();
+            }
+            
+            data.push_back(end - start);
+            data.insert(data.end(), name.begin() + start, name.begin() + end);
+            start = end + 1;
+        }
+        data.push_back(0);
+    }
+    
+    static void append_u16(std::vector<unsigned char> &data, uint16_t value) {
+        data.push_back(value >> 8);
+        data.push_back(value & 0xFF);
+    }
+    
+    // type, class IN, TTL 120 and the data length
+    static void append_record_header(std::vector<unsigned char> &data, uint16_t type, uint16_t data_length) {
+        append_u16(data, type);
+        append_u16(data, 1);
+        append_u16(data, 0);
+        append_u16(data, 120);
+        append_u16(data, data_length);
+    }
+    
+    std::vector<unsigned char> create_response() {
+        std::vector<unsigned char> data;
+        
+        // Header: response, authoritative, the question echoed, one answer, the A records
+        append_u16(data, 0);
+        append_u16(data, 0x8400);
+        append_u16(data, 1);
+        append_u16(data, 1);
+        append_u16(data, 0);
+        append_u16(data, m_config.addresses.size());
+        
+        append_name(data, m_config.service);
+        append_u16(data, 12);
+        append_u16(data, 1);
+        
+        // PTR with the owner compressed to the question name, "Host" + the same name
+        append_u16(data, 0xC00C);
+        append_record_header(data, 12, 7);
+        data.push_back(4);
+        data.insert(data.end(), { 'H', 'o', 's', 't' });
+        append_u16(data, 0xC00C);
+        
+        for (auto &address: m_config.addresses) {
+            append_name(data, "Host.local");
+            append_record_header(data, 1, 4);
+            
+            unsigned char bytes[4];
+            inet_pton(AF_INET, address.c_str(), bytes);
+            data.insert(data.end(), bytes, bytes + 4);
+        }
+        return data;
+    }
+    
+    ResponderConfig m_config;
+    int m_socket;
+    unsigned short m_port;
+    std::thread m_thread;
+    std::atomic<bool> m_is_running = {true};
+    std::atomic<int> m_queries = {0};
+};
+
+struct DiscoveryResult {
+    std::vector<std::string> addresses;
+    std::vector<long long> found_ms;
+    long long total_ms;
+    int queries;
+};
+
+static DiscoveryResult discover(const char *name, const ResponderConfig &config) {
+    DiscoveryResult result;
+    MdnsResponderStandIn responder(config);
+    
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [start] {
+        return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+    
+    discover_mdns_hosts(DISCOVERY_TIMEOUT_MS, [&](const std::string &address) {
+        result.addresses.push_back(address);
+        result.found_ms.push_back(elapsed_ms());
+    }, "127.0.0.1", responder.port());
+    
+    result.total_ms = elapsed_ms();
+    result.queries = responder.queries();
+    
+    printf("%-16s queries %i, found %zu:", name, result.queries, result.addresses.size());
+    for (size_t i = 0; i < result.addresses.size(); i++) {
+        printf(" %s in %lld ms", result.addresses[i].c_str(), result.found_ms[i]);
+    }
+    printf(", returned in %lld ms\n", result.total_ms);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    {
+        // Reported on the answer, not at the end of the timeout
+        ResponderConfig config;
+        config.latency_ms = 20;
+        config.addresses = { "192.168.1.10" };
+        
+        auto result = discover("answer", config);
+        CHECK(result.addresses == std::vector<std::string>({ "192.168.1.10" }));
+        CHECK(result.found_ms.size() == 1 && result.found_ms[0] < 200);
+        CHECK(result.total_ms >= DISCOVERY_TIMEOUT_MS);
+        // The repeats are spaced, all of them went out before the timeout
+        CHECK(result.queries == 3);
+    }
+    
+    {
+        // Found by a repeat, and reported once for the answers to all of them
+        ResponderConfig config;
+        config.dropped_queries = 1;
+        config.addresses = { "192.168.1.11" };
+        
+        auto result = discover("dropped query", config);
+        CHECK(result.addresses == std::vector<std::string>({ "192.168.1.11" }));
+        CHECK(result.found_ms.size() == 1 && result.found_ms[0] >= 200);
+    }
+    
+    {
+        ResponderConfig config;
+        config.dropped_queries = 3;
+        config.addresses = { "192.168.1.12" };
+        
+        auto result = discover("all dropped", config);
+        CHECK(result.addresses.empty());
+    }
+    
+    {
+        // A host with two interfaces
+        ResponderConfig config;
+        config.addresses = { "192.168.1.13", "10.0.0.13" };
+        
+        auto result = discover("two addresses", config);
+        CHECK(result.addresses == std::vector<std::string>({ "192.168.1.13", "10.0.0.13" }));
+    }
+    
+    {
+        ResponderConfig config;
+        
+        auto result = discover("no A record", config);
+        CHECK(result.addresses == std::vector<std::string>({ "127.0.0.1" }));
+    }
+    
+    {
+        ResponderConfig config;
+        config.service = "_other._tcp.local";
+        config.addresses = { "192.168.1.14" };
+        
+        auto result = discover("other service", config);
+        CHECK(result.addresses.empty());
+    }
+    
+    return test_exit_code();
+}
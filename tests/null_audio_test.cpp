@@ -0,0 +1,249 @@
+// Feeds NullAudioRenderer with 5 ms Opus packets in real time, while another
+// thread reads the stats like the overlay does. Checks the packet counters, that
+// the simulated device underruns on a stall only, that the queue is trimmed
+// after a burst and gets back near the target latency in a bounded time, the
+// concealment of lost packets, and the downmix of a 5.1 stream.
+//
+//   build/null_audio_test
+
+#include "NullAudioRenderer.hpp"
+#include "TestSupport.hpp"
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#define SAMPLE_RATE 48000
+#define CHANNEL_COUNT 2
+#define SURROUND_CHANNEL_COUNT 6
+#define PACKET_FRAMES 240
+#define MAX_PACKET_SIZE 1400
+
+// After a burst, the queue is dropped to 20 ms above the target right away,
+// the resampler drains the rest
+#define RECOVERY_MAX_MS 3000
+#define NEAR_TARGET_MS 15
+
+class PacketSource {
+public:
+    PacketSource(NullAudioRenderer *renderer, const OPUS_MULTISTREAM_CONFIGURATION &config): m_renderer(renderer), m_channel_count(config.channelCount) {
+        int error;
+        m_encoder = opus_multistream_encoder_create(config.sampleRate, config.channelCount, config.streams, config.coupledStreams, config.mapping, OPUS_APPLICATION_RESTRICTED_LOWDELAY, &error);
+        m_next_packet = std::chrono::steady_clock::now();
+    }
+    
+    ~PacketSource() {
+        opus_multistream_encoder_destroy(m_encoder);
+    }
+    
+    // Sends a packet every 5 ms, or all at once without pacing. Every lost_every
+    // packet is lost, the renderer gets a NULL for it.
+    void send(int count, bool paced, int lost_every = 0) {
+        for (int i = 0; i < count; i++) {
+            if (paced) {
+                m_next_packet += std::chrono::microseconds(1000000LL * PACKET_FRAMES / SAMPLE_RATE);
+                std::this_thread::sleep_until(m_next_packet);
+            }
+            
+            if (lost_every > 0 && i % lost_every == lost_every - 1) {
+                m_renderer->decode_and_play_sample(NULL, 0);
+                m_lost_packets++;
+                continue;
+            }
+            
+            int16_t pcm[PACKET_FRAMES * SURROUND_CHANNEL_COUNT];
+            for (int frame = 0; frame < PACKET_FRAMES; frame++) {
+                int16_t value = (int16_t)(8000 * sin(2 * M_PI * 440 * m_frame_index++ / SAMPLE_RATE));
+                for (int channel = 0; channel < m_channel_count; channel++) {
+                    pcm[frame * m_channel_count + channel] = value;
+                }
+            }
+            
+            unsigned char packet[MAX_PACKET_SIZE];
+            int length = opus_multistream_encode(m_encoder, pcm, PACKET_FRAMES, packet, sizeof(packet));
+            m_renderer->decode_and_play_sample((char *)packet, length);
+            m_sent_packets++;
+        }
+    }
+    
+    // The next paced packet is due after the pause
+    void pause(int ms) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        m_next_packet = std::chrono::steady_clock::now();
+    }
+    
+    uint32_t sent_packets() const {
+        return m_sent_packets;
+    }
+    
+    uint32_t lost_packets() const {
+        return m_lost_packets;
+    }
+    
+private:
+    NullAudioRenderer *m_renderer;
+    int m_channel_count;
+    OpusMSEncoder *m_encoder;
+    std::chrono::steady_clock::time_point m_next_packet;
+    uint64_t m_frame_index = 0;
+    uint32_t m_sent_packets = 0;
+    uint32_t m_lost_packets = 0;
+};
+
+static void print_stats(const char *phase, const AudioRenderStats &stats) {
+    printf("%-8s packets %5u/%5u  decode avg %6.1f us max %6llu us  queue %4u frames (max %4u, target %5.1f ms)  underruns %u  overruns %u  dropped %u  lost %u\n",
+           phase, stats.received_packets, stats.decoded_packets,
+           stats.decoded_packets > 0 ? (double)stats.total_decode_time_us / stats.decoded_packets : 0,
+           (unsigned long long)stats.max_decode_time_us, stats.queued_samples, stats.max_queued_samples,
+           stats.target_latency_ms, stats.underruns, stats.overruns, stats.dropped_packets, stats.lost_packets);
+}
+
+// The stats are filled in place, for one reader at a time like the UI thread
+static std::mutex stats_mutex;
+
+static AudioRenderStats read_stats(NullAudioRenderer &renderer) {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    return *renderer.audio_render_stats();
+}
+
+static float latency_above_target_ms(NullAudioRenderer &renderer) {
+    AudioRenderStats stats = read_stats(renderer);
+    return stats.latency_ms - stats.target_latency_ms;
+}
+
+// Sends paced packets until the latency is near the target, returns the time it took
+static int recover(PacketSource &source, NullAudioRenderer &renderer) {
+    const int packet_ms = 1000 * PACKET_FRAMES / SAMPLE_RATE;
+    int elapsed_ms = 0;
+    
+    while (elapsed_ms < RECOVERY_MAX_MS && latency_above_target_ms(renderer) > NEAR_TARGET_MS) {
+        source.send(1, true);
+        elapsed_ms += packet_ms;
+    }
+    
+    printf("%-8s %4i ms to %.1f ms above the target\n", "recovery", elapsed_ms, latency_above_target_ms(renderer));
+    return elapsed_ms;
+}
+
+// The device is stereo like the audren sink, a 5.1 stream is downmixed
+static void check_surround() {
+    OPUS_MULTISTREAM_CONFIGURATION config = {};
+    config.sampleRate = SAMPLE_RATE;
+    config.channelCount = SURROUND_CHANNEL_COUNT;
+    config.streams = 4;
+    config.coupledStreams = 2;
+    config.samplesPerFrame = PACKET_FRAMES;
+    
+    const unsigned char mapping[] = { 0, 4, 1, 5, 2, 3 };
+    memcpy(config.mapping, mapping, sizeof(mapping));
+    
+    NullAudioRenderer renderer;
+    
+    if (renderer.init(AUDIO_CONFIGURATION_51_SURROUND, &config, NULL, 0) != DR_OK) {
+        fprintf(stderr, "NullAudioRenderer 5.1 init failed\n");
+        CHECK(false);
+        return;
+    }
+    
+    renderer.start();
+    
+    PacketSource source(&renderer, config);
+    source.send(200, true);
+    
+    AudioRenderStats surround = read_stats(renderer);
+    print_stats("5.1", surround);
+    CHECK(surround.decoded_packets == 200);
+    CHECK(surround.downmixed_packets == surround.decoded_packets);
+    CHECK(surround.underruns == 0);
+    CHECK(surround.overruns == 0);
+    
+    renderer.cleanup();
+}
+
+int main(int argc, char **argv) {
+    OPUS_MULTISTREAM_CONFIGURATION config = {};
+    config.sampleRate = SAMPLE_RATE;
+    config.channelCount = CHANNEL_COUNT;
+    config.streams = 1;
+    config.coupledStreams = 1;
+    config.samplesPerFrame = PACKET_FRAMES;
+    config.mapping[0] = 0;
+    config.mapping[1] = 1;
+    
+    NullAudioRenderer renderer;
+    
+    if (renderer.init(AUDIO_CONFIGURATION_STEREO, &config, NULL, 0) != DR_OK) {
+        fprintf(stderr, "NullAudioRenderer init failed\n");
+        return 1;
+    }
+    
+    renderer.start();
+    
+    // The overlay reads the stats on the UI thread, while packets are decoded
+    std::atomic<bool> is_running = {true};
+    std::atomic<uint32_t> stats_reads = {0};
+    std::thread reader([&] {
+        while (is_running) {
+            AudioRenderStats stats = read_stats(renderer);
+            if (stats.decoded_packets >= stats.received_packets) {
+                stats_reads++;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    
+    PacketSource source(&renderer, config);
+    
+    // 2 seconds in real time, the device starts once the queue reached the target
+    source.send(400, true);
+    AudioRenderStats steady = read_stats(renderer);
+    print_stats("steady", steady);
+    CHECK(steady.received_packets == 400);
+    CHECK(steady.decoded_packets == 400);
+    CHECK(steady.max_decode_time_us <= steady.total_decode_time_us);
+    CHECK(steady.underruns == 0);
+    CHECK(steady.overruns == 0);
+    
+    // The device drains the queue while nothing arrives
+    source.pause(150);
+    source.send(200, true);
+    AudioRenderStats stall = read_stats(renderer);
+    print_stats("stall", stall);
+    CHECK(stall.underruns >= 1);
+    CHECK(stall.overruns == 0);
+    
+    // 500 ms at once would overflow the 250 ms ring, the packets above the limit are dropped
+    source.send(100, false);
+    AudioRenderStats burst = read_stats(renderer);
+    print_stats("burst", burst);
+    CHECK(burst.overruns == 0);
+    CHECK(burst.dropped_packets >= 80);
+    CHECK(burst.latency_ms <= burst.target_latency_ms + 30);
+    
+    CHECK(recover(source, renderer) < RECOVERY_MAX_MS);
+    
+    // A gap is concealed when the next packet arrives, the last lost packet from its FEC.
+    // The gap size is estimated by the arrival time, a late packet may count more.
+    source.send(200, true, 10);
+    source.send(1, true);
+    AudioRenderStats loss = read_stats(renderer);
+    print_stats("loss", loss);
+    CHECK(loss.received_packets == source.sent_packets());
+    CHECK(loss.decoded_packets == source.sent_packets());
+    CHECK(loss.lost_packets >= source.lost_packets());
+    CHECK(loss.fec_frames == source.lost_packets());
+    CHECK(loss.concealed_frames + loss.fec_frames == loss.lost_packets);
+    
+    // It stays near the target, give or take a device period
+    CHECK(latency_above_target_ms(renderer) <= NEAR_TARGET_MS + 1000 * PACKET_FRAMES / SAMPLE_RATE);
+    
+    is_running = false;
+    reader.join();
+    renderer.cleanup();
+    
+    CHECK(stats_reads > 0);
+    
+    check_surround();
+    return test_exit_code();
+}
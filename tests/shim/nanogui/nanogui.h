@@ -0,0 +1,8 @@
+#include <functional>
+#pragma once
+
+// The part of nanogui which GameStreamClient uses. A test defines async() and runs
+// the queued callbacks on its main thread, like the nanogui main loop does.
+namespace nanogui {
+    void async(const std::function<void()> &func);
+}
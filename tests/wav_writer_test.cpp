@@ -0,0 +1,139 @@
+// Records a known stereo signal with WavFileWriter, in packet sized writes like the
+// debug recorder, then reads the file back and checks the RIFF header and the samples.
+//
+//   build/wav_writer_test
+
+#include "WavFileWriter.hpp"
+#include "TestSupport.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#define SAMPLE_RATE 48000
+#define CHANNEL_COUNT 2
+#define PACKET_FRAMES 240
+#define PACKET_COUNT 400
+#define WAV_HEADER_SIZE 44
+
+static uint16_t get_u16(const uint8_t *src) {
+    return src[0] | (src[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *src) {
+    return get_u16(src) | ((uint32_t)get_u16(src + 2) << 16);
+}
+
+// A ramp which wraps around, every sample is different from its neighbours
+static int16_t signal_sample(size_t index) {
+    return (int16_t)((index * 7919) & 0xFFFF);
+}
+
+static std::vector<uint8_t> read_file(const std::string &path) {
+    std::vector<uint8_t> bytes;
+    FILE *file = fopen(path.c_str(), "rb");
+    
+    if (!file) {
+        return bytes;
+    }
+    
+    uint8_t buffer[4096];
+    size_t count;
+    
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + count);
+    }
+    
+    fclose(file);
+    return bytes;
+}
+
+static void check_recording(const std::string &path) {
+    const size_t packet_samples = PACKET_FRAMES * CHANNEL_COUNT;
+    const size_t sample_count = packet_samples * PACKET_COUNT;
+    
+    WavFileWriter writer;
+    CHECK(writer.open(path, SAMPLE_RATE, CHANNEL_COUNT));
+    CHECK(writer.is_open());
+    
+    std::vector<int16_t> packet(packet_samples);
+    
+    for (size_t i = 0; i < PACKET_COUNT; i++) {
+        for (size_t j = 0; j < packet_samples; j++) {
+            packet[j] = signal_sample(i * packet_samples + j);
+        }
+        CHECK(writer.write(packet.data(), packet.size()) == packet.size());
+    }
+    
+    // Two seconds fit in the ring, nothing is dropped even if the writer thread didn't run yet
+    writer.close();
+    CHECK(!writer.is_open());
+    CHECK(writer.dropped_samples() == 0);
+    CHECK(writer.write(packet.data(), packet.size()) == 0);
+    
+    auto bytes = read_file(path);
+    const uint32_t data_size = sample_count * sizeof(int16_t);
+    
+    CHECK(bytes.size() == WAV_HEADER_SIZE + data_size);
+    
+    if (bytes.size() != WAV_HEADER_SIZE + data_size) {
+        return;
+    }
+    
+    const uint8_t *header = bytes.data();
+    CHECK(memcmp(header, "RIFF", 4) == 0);
+    CHECK(get_u32(header + 4) == WAV_HEADER_SIZE - 8 + data_size);
+    CHECK(memcmp(header + 8, "WAVE", 4) == 0);
+    CHECK(memcmp(header + 12, "fmt ", 4) == 0);
+    CHECK(get_u32(header + 16) == 16);
+    CHECK(get_u16(header + 20) == 1);
+    CHECK(get_u16(header + 22) == CHANNEL_COUNT);
+    CHECK(get_u32(header + 24) == SAMPLE_RATE);
+    CHECK(get_u32(header + 28) == SAMPLE_RATE * CHANNEL_COUNT * sizeof(int16_t));
+    CHECK(get_u16(header + 32) == CHANNEL_COUNT * sizeof(int16_t));
+    CHECK(get_u16(header + 34) == 16);
+    CHECK(memcmp(header + 36, "data", 4) == 0);
+    CHECK(get_u32(header + 40) == data_size);
+    
+    size_t mismatches = 0;
+    
+    for (size_t i = 0; i < sample_count; i++) {
+        if ((int16_t)get_u16(header + WAV_HEADER_SIZE + i * sizeof(int16_t)) != signal_sample(i)) {
+            mismatches++;
+        }
+    }
+    
+    printf("%zu samples, %zu bytes, %zu mismatches\n", sample_count, bytes.size(), mismatches);
+    CHECK(mismatches == 0);
+}
+
+static void check_failed_open(const std::string &working_dir) {
+    WavFileWriter writer;
+    int16_t samples[CHANNEL_COUNT] = {};
+    
+    CHECK(!writer.open(working_dir + "/missing/recording.wav", SAMPLE_RATE, CHANNEL_COUNT));
+    CHECK(!writer.is_open());
+    CHECK(writer.write(samples, CHANNEL_COUNT) == 0);
+    writer.close();
+}
+
+int main(int argc, char **argv) {
+    char working_dir[] = "/tmp/wav_writer_test_XXXXXX";
+    if (!mkdtemp(working_dir)) {
+        return 1;
+    }
+    
+    std::string path = std::string(working_dir) + "/recording.wav";
+    
+    check_recording(path);
+    
+    // A new recording replaces the old file
+    check_recording(path);
+    check_failed_open(working_dir);
+    
+    unlink(path.c_str());
+    rmdir(working_dir);
+    return test_exit_code();
+}
@@ -0,0 +1,150 @@
+// Parses a serverinfo response with the single expat pass, fed whole and in chunks
+// like a download, and compares it with a status pass plus a search pass per field.
+//
+//   build/xml_bench [iterations]
+
+#include "xml.h"
+#include "errors.h"
+#include "TestSupport.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FIXTURES_DIR
+#define FIXTURES_DIR "tests/fixtures"
+#endif
+
+#define DEFAULT_ITERATION_COUNT 2000
+
+// About one TCP segment of the response body
+#define CHUNK_SIZE 1448
+
+static uint64_t get_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void free_modes(PSERVER_INFO_XML info) {
+    while (info->modes != NULL) {
+        PDISPLAY_MODE next = info->modes->next;
+        free(info->modes);
+        info->modes = next;
+    }
+}
+
+static int count_modes(const SERVER_INFO_XML &info) {
+    int count = 0;
+    
+    for (PDISPLAY_MODE mode = info.modes; mode != NULL; mode = mode->next) {
+        count++;
+    }
+    return count;
+}
+
+// The fields, one document scan per each
+static int parse_separately(const Data &data, PSERVER_INFO_XML info) {
+    int status = xml_status(data);
+    
+    if (status != GS_OK) {
+        return status;
+    }
+    
+    xml_search(data, "currentgame", &info->currentGame);
+    xml_search(data, "PairStatus", &info->pairStatus);
+    xml_search(data, "appversion", &info->appVersion);
+    xml_search(data, "state", &info->state);
+    xml_search(data, "ServerCodecModeSupport", &info->serverCodecModeSupport);
+    xml_search(data, "gputype", &info->gpuType);
+    xml_search(data, "GsVersion", &info->gsVersion);
+    xml_search(data, "hostname", &info->hostname);
+    xml_search(data, "GfeVersion", &info->gfeVersion);
+    xml_search(data, "mac", &info->mac);
+    return GS_OK;
+}
+
+static int parse_stream(const Data &data, size_t chunk_size, PSERVER_INFO_XML info) {
+    PXML_STREAM stream = xml_serverinfo_stream(info);
+    
+    for (size_t offset = 0; offset < data.size(); offset += chunk_size) {
+        size_t size = std::min(chunk_size, data.size() - offset);
+        
+        if (xml_stream_write(stream, (const char *)data.bytes() + offset, size) != GS_OK) {
+            xml_stream_free(stream);
+            return GS_INVALID;
+        }
+    }
+    return xml_stream_finish(stream);
+}
+
+static bool same_fields(const SERVER_INFO_XML &a, const SERVER_INFO_XML &b) {
+    return a.currentGame == b.currentGame && a.pairStatus == b.pairStatus && a.appVersion == b.appVersion &&
+        a.state == b.state && a.serverCodecModeSupport == b.serverCodecModeSupport && a.gpuType == b.gpuType &&
+        a.gsVersion == b.gsVersion && a.hostname == b.hostname && a.gfeVersion == b.gfeVersion && a.mac == b.mac;
+}
+
+static void check_results(const Data &data) {
+    SERVER_INFO_XML separate = {};
+    CHECK(parse_separately(data, &separate) == GS_OK);
+    CHECK(separate.hostname == "GAMING-PC");
+    CHECK(separate.pairStatus == "1");
+    CHECK(separate.currentGame == "0");
+    
+    SERVER_INFO_XML whole = {};
+    CHECK(parse_stream(data, data.size(), &whole) == GS_OK);
+    CHECK(same_fields(separate, whole));
+    CHECK(count_modes(whole) == 7);
+    free_modes(&whole);
+    
+    SERVER_INFO_XML chunked = {};
+    CHECK(parse_stream(data, CHUNK_SIZE, &chunked) == GS_OK);
+    CHECK(same_fields(separate, chunked));
+    CHECK(count_modes(chunked) == 7);
+    free_modes(&chunked);
+}
+
+template<typename Parse>
+static void run(const char *name, int iteration_count, Parse parse) {
+    uint64_t before = get_time_us();
+    
+    for (int i = 0; i < iteration_count; i++) {
+        SERVER_INFO_XML info = {};
+        parse(&info);
+        free_modes(&info);
+    }
+    
+    printf("%-28s %8.2f us per response\n", name, (double)(get_time_us() - before) / iteration_count);
+}
+
+int main(int argc, char **argv) {
+    int iteration_count = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATION_COUNT;
+    
+    Data data = Data::read_from_file(FIXTURES_DIR "/serverinfo.xml");
+    
+    if (data.is_empty() || iteration_count <= 0) {
+        fprintf(stderr, "No %s\n", FIXTURES_DIR "/serverinfo.xml");
+        return 1;
+    }
+    
+    check_results(data);
+    
+    if (test_failures() > 0) {
+        return test_exit_code();
+    }
+    
+    printf("%zu bytes serverinfo, %i iterations\n", data.size(), iteration_count);
+    
+    // Doesn't count the display mode pass that the old code did on top
+    run("status + search per field", iteration_count, [&](PSERVER_INFO_XML info) {
+        parse_separately(data, info);
+    });
+    
+    run("stream, whole", iteration_count, [&](PSERVER_INFO_XML info) {
+        parse_stream(data, data.size(), info);
+    });
+    
+    run("stream, 1448 byte chunks", iteration_count, [&](PSERVER_INFO_XML info) {
+        parse_stream(data, CHUNK_SIZE, info);
+    });
+    return test_exit_code();
+}